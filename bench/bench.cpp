@@ -0,0 +1,455 @@
+// bench.cpp - nanoseconds per call of the numerical kernels, written as JSON.
+// bench [-o file] [-f filter] [-t seconds] [-c baseline.json [-p percent]]
+// Each kernel runs over a fixed batch of inputs drawn with philox from the ranges of test_bms_args.
+// A kernel is timed in repeated samples of at least t/10 seconds and ns_per_op is the fastest sample,
+// which is the least disturbed by the rest of the machine. With -c the run is compared to a stored
+// baseline and the exit code is 1 if any kernel is more than percent (default 10) slower.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "../black.h"
+#include "../lkk.h"
+#include "../philox.h"
+#include "../bms_c.h"
+#include "../branches/jiejie/XlltestProj/putPricer.h"
+#ifdef BMS_HAVE_JR
+#include "../jr.h"
+#endif
+
+using namespace std::chrono;
+
+// batch size of every kernel
+static const std::size_t N = 1024;
+
+// results land here so the compiler cannot drop the calls
+static volatile double sink;
+
+// uniforms in (lo, hi) from one philox stream per input
+struct inputs {
+	rng::philox r;
+
+	explicit inputs(std::uint64_t stream)
+		: r(stream)
+	{ }
+
+	std::vector<double> uniform(double lo, double hi, std::size_t n = N)
+	{
+		std::vector<double> x(n);
+
+		r.real(n, &x[0]);
+		for (std::size_t i = 0; i < n; ++i)
+			x[i] = lo + (hi - lo)*x[i];
+
+		return x;
+	}
+};
+
+// random Black arguments like test_bms_args, puts have negative strikes
+struct bms_args {
+	std::vector<double> f, sigma, k, t;
+
+	bms_args()
+	{
+		inputs in(1);
+		f = in.uniform(90, 110);
+		sigma = in.uniform(.01, .5);
+		k = in.uniform(90, 110);
+		t = in.uniform(.1, 2);
+		std::vector<double> cp = in.uniform(0, 1);
+		for (std::size_t i = 0; i < N; ++i)
+			if (cp[i] > .5)
+				k[i] = -k[i];
+	}
+};
+
+// Black prices on a grid of standardized moneyness and expirations with their volatilities
+struct implied_args {
+	std::vector<double> p, k, t, sigma;
+	double f;
+
+	implied_args()
+		: f(100)
+	{
+		const double T[] = {1./12, .25, .5, 1, 2, 5};
+		const std::size_t nt = sizeof(T)/sizeof(*T), nm = (N + nt - 1)/nt;
+		inputs in(2);
+		std::vector<double> s = in.uniform(.05, .8);
+
+		for (std::size_t i = 0; i < N; ++i) {
+			double m = -2 + 4.*(i/nt)/(nm - 1); // standard deviations from the forward
+			double sigma_ = s[i], t_ = T[i%nt], k_ = f*exp(m*sigma_*sqrt(t_));
+			if (m < 0)
+				k_ = -k_; // out of the money put
+
+			sigma.push_back(sigma_);
+			k.push_back(k_);
+			t.push_back(t_);
+			p.push_back(black::value(f, sigma_, k_, t_));
+		}
+	}
+};
+
+struct kernel {
+	std::string name;
+	std::function<void(void)> run; // one pass over N inputs
+};
+
+struct result {
+	double ns_per_op, median_ns_per_op;
+	std::size_t samples;
+};
+
+// time whole passes over the batch for about seconds
+static result measure(const kernel& k, double seconds)
+{
+	// passes per sample so a sample takes at least seconds/10
+	std::size_t reps = 1;
+	for (;;) {
+		steady_clock::time_point t0 = steady_clock::now();
+		for (std::size_t i = 0; i < reps; ++i)
+			k.run();
+		double dt = duration<double>(steady_clock::now() - t0).count();
+		if (dt >= seconds/10 || reps > (std::size_t(1) << 30))
+			break;
+		reps *= dt > 0 ? std::max<std::size_t>(2, static_cast<std::size_t>(seconds/10/dt)) : 16;
+	}
+
+	std::vector<double> ns;
+	steady_clock::time_point end = steady_clock::now() + duration_cast<steady_clock::duration>(duration<double>(seconds));
+	while (ns.size() < 5 || steady_clock::now() < end) {
+		steady_clock::time_point t0 = steady_clock::now();
+		for (std::size_t i = 0; i < reps; ++i)
+			k.run();
+		ns.push_back(duration<double, std::nano>(steady_clock::now() - t0).count()/(reps*N));
+	}
+	std::sort(ns.begin(), ns.end());
+
+	result r = {ns.front(), ns[ns.size()/2], ns.size()};
+
+	return r;
+}
+
+static std::vector<kernel> kernels(void)
+{
+	static const bms_args b;
+	static const implied_args iv;
+	static std::vector<double> y(N), g[4];
+	for (int i = 0; i < 4; ++i)
+		g[i].resize(N);
+	std::vector<kernel> ks;
+
+	// Black value and each greek
+	ks.push_back({"black::value", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::value(b.f[i], b.sigma[i], b.k[i], b.t[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::delta", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::delta(b.f[i], b.sigma[i], b.k[i], b.t[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::gamma", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::gamma(b.f[i], b.sigma[i], b.k[i], b.t[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::vega", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::vega(b.f[i], b.sigma[i], b.k[i], b.t[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::theta", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::theta(b.f[i], b.sigma[i], b.k[i], b.t[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::greeks", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::greeks(b.f[i], b.sigma[i], b.k[i], b.t[i], &g[0][i], &g[1][i], &g[2][i], &g[3][i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::black[n]", []() {
+		black::black(N, &b.f[0], &b.sigma[0], &b.k[0], &b.t[0], &y[0], &g[0][0], &g[1][0], &g[2][0], &g[3][0]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::binary", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::binary(b.f[i], b.sigma[i], b.k[i], b.t[i]);
+		sink = y[N - 1];
+	}});
+
+	// implied volatility over moneyness and expiration
+	ks.push_back({"black::implied_volatility", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::implied_volatility(iv.f, iv.p[i], iv.k[i], iv.t[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"black::corrado_miller_implied_volatility", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = black::corrado_miller_implied_volatility(iv.f, iv.p[i], iv.k[i], iv.t[i]);
+		sink = y[N - 1];
+	}});
+
+	// normal policies
+	static const std::vector<double> x = inputs(3).uniform(-6, 6), p = inputs(4).uniform(0, 1);
+	ks.push_back({"normal_pdf", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_pdf(x[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_cdf<ooura>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_cdf<ooura>(x[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_cdf<daly>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_cdf<daly>(x[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_cdf<AS_P1>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_cdf<AS_P1>(x[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_cdf<AS_P2>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_cdf<AS_P2>(x[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_inv<ooura>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_inv<ooura>(p[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_inv<ooura>[n]", []() {
+		normal_inv<ooura>(N, &p[0], &y[0]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_inv<AS_P1>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_inv<AS_P1>(p[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_inv<zyang>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_inv<zyang>(p[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normal_inv<daly>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = normal_inv<daly>(p[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"derfc<ooura>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = derfc<ooura>(x[i]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"dierfc<ooura>", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = dierfc<ooura>(2*p[i]);
+		sink = y[N - 1];
+	}});
+
+	// LKK with the parameters of lkk_cdf, the trapezoid walk is the reference for the closed forms
+	static const double s = .3, a = .02, bb = .01;
+	static const std::vector<double> lx = inputs(5).uniform(-4*s, 4*s), lk = inputs(6).uniform(100*exp(-2*s), 100*exp(2*s));
+	ks.push_back({"lkk::pdf", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = lkk::pdf<double,double,double,double,double>(lx[i], s, a, bb);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::cdf", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = lkk::cdf<double,double,double,double,double>(lx[i], s, a, bb);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::cdf[n]", []() {
+		lkk::cdf(N, &lx[0], &y[0], s, a, bb);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::cdf_trapezoid", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = lkk::cdf_trapezoid<double,double,double,double,double>(lx[i], s, a, bb);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::put", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = lkk::put<double,double,double,double,double>(100., s, a, bb, lk[i], 1.);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::put[n]", []() {
+		lkk::put(100, s, a, bb, N, &lk[0], &y[0], 1);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::put_trapezoid", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = lkk::put_trapezoid<double,double,double,double,double>(100., s, a, bb, lk[i], 1.);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::distribution::pdf[n]", []() {
+		lkk::distribution(s, a, bb).pdf(N, &lx[0], &y[0]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"lkk::quantile[n]", []() {
+		static const lkk::quantile q(s, a, bb);
+		q(N, &p[0], &y[0]);
+		sink = y[N - 1];
+	}});
+
+#ifdef BMS_HAVE_JR
+	ks.push_back({"jr::value", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = jr::value(100, 0, b.t[i], b.sigma[i], b.k[i], 0, 0, 0);
+		sink = y[N - 1];
+	}});
+#endif
+
+	// normalexp of the jiejie branch, the inverse through the C interface since normalexp.h has its own normal.h
+	ks.push_back({"putPricer", []() {
+		for (std::size_t i = 0; i < N; ++i)
+			y[i] = putPricer(100, b.sigma[i], fabs(b.k[i]), b.t[i], -1.5, 2);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"normalexp_inv[n]", []() {
+		bms_normalexp_inv_n(N, &p[0], -1.5, 2, &y[0]);
+		sink = y[N - 1];
+	}});
+	ks.push_back({"putChain", []() {
+		static std::vector<double> k(N);
+		for (std::size_t i = 0; i < N; ++i)
+			k[i] = fabs(b.k[i]);
+		putChain(100, .2, 1, -1.5, 2, static_cast<int>(N), &k[0], &y[0]);
+		sink = y[N - 1];
+	}});
+
+	return ks;
+}
+
+// name -> ns_per_op from the JSON this program writes
+static std::map<std::string, double> read_baseline(const char* file)
+{
+	std::map<std::string, double> r;
+	FILE* fp = fopen(file, "r");
+
+	if (!fp) {
+		fprintf(stderr, "bench: cannot read %s\n", file);
+		exit(2);
+	}
+
+	std::string s;
+	char buf[4096];
+	for (std::size_t n; (n = fread(buf, 1, sizeof(buf), fp)) > 0; )
+		s.append(buf, n);
+	fclose(fp);
+
+	const std::string key = "\"name\": \"", ns = "\"ns_per_op\": ";
+	for (std::size_t i = s.find(key); i != std::string::npos; i = s.find(key, i)) {
+		i += key.size();
+		std::size_t j = s.find('"', i), l = s.find(ns, j);
+		if (j == std::string::npos || l == std::string::npos)
+			break;
+		r[s.substr(i, j - i)] = atof(s.c_str() + l + ns.size());
+	}
+
+	return r;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* out = 0;
+	const char* filter = "";
+	const char* baseline = 0;
+	double seconds = .5, percent = 10;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			out = argv[++i];
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+			baseline = argv[++i];
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+			percent = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-o file] [-f filter] [-t seconds] [-c baseline.json [-p percent]]\n", argv[0]);
+
+			return 2;
+		}
+	}
+
+	std::map<std::string, double> base;
+	if (baseline) {
+		base = read_baseline(baseline);
+		fprintf(stderr, "%-40s %13s %13s %8s\n", "kernel", "baseline", "current", "change");
+	}
+
+	FILE* fp = out ? fopen(out, "w") : stdout;
+	if (!fp) {
+		fprintf(stderr, "bench: cannot write %s\n", out);
+
+		return 2;
+	}
+
+	std::vector<kernel> ks = kernels();
+	std::map<std::string, double> unrun = base; // baseline kernels not measured yet
+	int regressions = 0, missing = 0;
+	bool first = true;
+
+	fprintf(fp, "{\n  \"batch\": %zu,\n  \"kernels\": [", N);
+	for (const kernel& k : ks) {
+		if (!strstr(k.name.c_str(), filter))
+			continue;
+
+		result r = measure(k, seconds);
+		fprintf(fp, "%s\n    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"median_ns_per_op\": %.3f, \"ops_per_sec\": %.0f, \"samples\": %zu}",
+			first ? "" : ",", k.name.c_str(), r.ns_per_op, r.median_ns_per_op, 1e9/r.ns_per_op, r.samples);
+		fflush(fp);
+		first = false;
+
+		if (baseline) {
+			std::map<std::string, double>::const_iterator b = base.find(k.name);
+			if (b == base.end()) {
+				fprintf(stderr, "%-40s %10.2f ns  (not in baseline)\n", k.name.c_str(), r.ns_per_op);
+			}
+			else {
+				double change = 100*(r.ns_per_op/b->second - 1);
+				bool slow = change > percent;
+				fprintf(stderr, "%-40s %10.2f ns %10.2f ns %+7.1f%%%s\n", k.name.c_str(), b->second, r.ns_per_op, change,
+					slow ? "  REGRESSION" : "");
+				regressions += slow;
+				unrun.erase(k.name);
+			}
+		}
+	}
+	fprintf(fp, "\n  ]\n}\n");
+
+	// a kernel in the baseline that was not filtered out but no longer exists is a failure
+	for (std::map<std::string, double>::const_iterator b = unrun.begin(); b != unrun.end(); ++b) {
+		if (!strstr(b->first.c_str(), filter))
+			continue;
+		fprintf(stderr, "%-40s %10.2f ns  (not run)\n", b->first.c_str(), b->second);
+		++missing;
+	}
+
+	if (out)
+		fclose(fp);
+
+	if (regressions)
+		fprintf(stderr, "bench: %d kernel%s more than %g%% slower than %s\n", regressions, regressions == 1 ? "" : "s", percent, baseline);
+	if (missing)
+		fprintf(stderr, "bench: %d kernel%s in %s not run\n", missing, missing == 1 ? "" : "s", baseline);
+
+	return regressions != 0 || missing != 0;
+}
@@ -0,0 +1,64 @@
+// lkk_cdf.cpp - latency and error of the closed form LKK cdf and put versus the trapezoid walk
+// g++ -O2 -I.. lkk_cdf.cpp -o lkk_cdf
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "../lkk.h"
+
+using namespace std::chrono;
+
+// average nanoseconds per call of f(x[i])
+template<class F>
+inline double ns_per_call(const std::vector<double>& x, std::vector<double>& y, F f)
+{
+	auto t0 = steady_clock::now();
+	for (size_t i = 0; i < x.size(); ++i)
+		y[i] = f(x[i]);
+	auto t1 = steady_clock::now();
+
+	return duration<double, std::nano>(t1 - t0).count()/x.size();
+}
+
+inline double max_abs_diff(const std::vector<double>& y0, const std::vector<double>& y1)
+{
+	double e(0);
+
+	for (size_t i = 0; i < y0.size(); ++i)
+		e = fmax(e, fabs(y0[i] - y1[i]));
+
+	return e;
+}
+
+int main()
+{
+	const double params[][3] = { // s, a, b
+		{.5, .05, .03},
+		{.3, .02, .01},
+		{1., .2, .3},
+	};
+	const size_t n = 1000;
+
+	printf("%-18s %12s %12s %12s %12s\n", "s, a, b", "walk ns", "closed ns", "speedup", "max |err|");
+	for (const auto& p : params) {
+		double s = p[0], a = p[1], b = p[2];
+		std::vector<double> x(n), y0(n), y1(n);
+
+		for (size_t i = 0; i < n; ++i)
+			x[i] = -4*s + 8*s*i/(n - 1);
+
+		double t0 = ns_per_call(x, y0, [=](double x_) { return lkk::cdf_trapezoid<double,double,double,double,double>(x_, s, a, b); });
+		double t1 = ns_per_call(x, y1, [=](double x_) { return lkk::cdf<double,double,double,double,double>(x_, s, a, b); });
+
+		printf("cdf %4g %4g %4g %12.0f %12.1f %12.0f %12.2e\n", s, a, b, t0, t1, t0/t1, max_abs_diff(y0, y1));
+
+		for (size_t i = 0; i < n; ++i)
+			x[i] = 100*exp(-2*s + 4*s*i/(n - 1));
+
+		t0 = ns_per_call(x, y0, [=](double k) { return lkk::put_trapezoid<double,double,double,double,double>(100., s, a, b, k, 1.); });
+		t1 = ns_per_call(x, y1, [=](double k) { return lkk::put<double,double,double,double,double>(100., s, a, b, k, 1.); });
+
+		printf("put %4g %4g %4g %12.0f %12.1f %12.0f %12.2e\n", s, a, b, t0, t1, t0/t1, max_abs_diff(y0, y1));
+	}
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+// replay.cpp - end to end latency of the tick to greeks pipeline replaying a file of ticks.
+// replay [-s solvers] [-k greeks] [-x speed] file
+// replay -g ticks instruments rate file
+// -g writes ticks at about rate per second on instruments with random forwards, strikes, expirations
+// and volatilities. -x replays at speed times the recorded pace, the default 0 is as fast as possible.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "../philox.h"
+#include "../pipeline.h"
+
+static int generate(std::size_t n, std::size_t m, double rate, const char* file)
+{
+	FILE* fp = fopen(file, "w");
+	if (!fp) {
+		fprintf(stderr, "replay: cannot write %s\n", file);
+
+		return 2;
+	}
+
+	rng::philox r(1);
+	std::vector<double> f(m), k(m), t(m), sigma(m);
+	for (std::size_t i = 0; i < m; ++i) {
+		f[i] = 90 + 20*r.real();
+		t[i] = .05 + 2*r.real();
+		sigma[i] = .1 + .4*r.real();
+		k[i] = f[i]*exp(sigma[i]*sqrt(t[i])*(2*r.real() - 1));
+		if (k[i] < f[i])
+			k[i] = -k[i]; // out of the money put
+	}
+
+	fprintf(fp, "# time,instrument,forward,price,strike,expiration\n");
+	double time = 0;
+	for (std::size_t j = 0; j < n; ++j) {
+		time += -log(r.real())/rate;
+		std::size_t i = r() % m;
+		f[i] *= exp(1e-4*normal_inv<ooura>(r.real()));
+		double s = sigma[i]*(1 + .01*(2*r.real() - 1));
+		fprintf(fp, "%.9f,%zu,%.10g,%.10g,%.10g,%.10g\n", time, i, f[i], black::value(f[i], s, k[i], t[i]), k[i], t[i]);
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::size_t solvers = 1, greeks = 1;
+	double speed = 0;
+	int i = 1;
+
+	if (argc == 6 && !strcmp(argv[1], "-g"))
+		return generate(strtoul(argv[2], 0, 10), strtoul(argv[3], 0, 10), atof(argv[4]), argv[5]);
+
+	for (; i < argc - 1; ++i) {
+		if (!strcmp(argv[i], "-s"))
+			solvers = strtoul(argv[++i], 0, 10);
+		else if (!strcmp(argv[i], "-k"))
+			greeks = strtoul(argv[++i], 0, 10);
+		else if (!strcmp(argv[i], "-x"))
+			speed = atof(argv[++i]);
+		else
+			break;
+	}
+	if (i != argc - 1 || solvers == 0 || greeks == 0) {
+		fprintf(stderr, "usage: %s [-s solvers] [-k greeks] [-x speed] file\n       %s -g ticks instruments rate file\n", argv[0], argv[0]);
+
+		return 2;
+	}
+
+	try {
+		std::vector<pipeline::tick> ts = pipeline::read(argv[i]);
+		std::size_t m = 0;
+		for (std::size_t j = 0; j < ts.size(); ++j)
+			if (ts[j].instrument >= m)
+				m = ts[j].instrument + 1;
+
+		pipeline::engine e(m ? m : 1, solvers, greeks);
+		e.start();
+		pipeline::clock::time_point t0 = pipeline::clock::now();
+		pipeline::replay(e, ts, speed);
+		e.stop();
+		double dt = std::chrono::duration<double>(pipeline::clock::now() - t0).count();
+
+		statistics::digest l = e.latency();
+		const pipeline::totals& p = e.portfolio();
+		printf("ticks      %zu in %.3f s, %.0f per second\n", e.pushed(), dt, e.pushed()/dt);
+		printf("priced     %zu\nconflated  %zu\nfailed     %zu\n", e.solved(), e.conflated(), e.failed());
+		printf("latency us p50 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+			l.quantile(.5)*1e-3, l.quantile(.99)*1e-3, l.quantile(.999)*1e-3, l.quantile(1)*1e-3);
+		printf("portfolio  value %.6g  delta %.6g  gamma %.6g  vega %.6g  theta %.6g\n", p.value, p.delta, p.gamma, p.vega, p.theta);
+	}
+	catch (const std::exception& ex) {
+		fprintf(stderr, "replay: %s\n", ex.what());
+
+		return 1;
+	}
+
+	return 0;
+}
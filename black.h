@@ -1,9 +1,32 @@
 // black.h - Fischer Black model that uses forwards and no rates.
 // Copyright (c) 2006-2009 KALX, LLC. All rights reserved. No warranty is made.
+// greeks, binary and corrado_miller_implied_volatility are defined here and are now the source of truth.
+// They replace the versions in ../fmsgjr/black.h that the Windows build of xllblack.cpp used to include.
 #pragma once
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <limits>
 #include "normal.h"
 
+#ifndef ensure
+#include <cassert>
+#define ensure(x) assert(x)
+#endif
+
+#ifndef __max
+#define __max(a,b) (((a) > (b)) ? (a) : (b))
+#endif
+
+// Define BLACK_IMPLIED_TELEMETRY to record how each implied volatility was solved, see implied_telemetry.h.
+// Otherwise the statements in BLACK_IMPLIED_TRACE are not compiled.
+#ifdef BLACK_IMPLIED_TELEMETRY
+#include "implied_telemetry.h"
+#define BLACK_IMPLIED_TRACE(...) __VA_ARGS__
+#else
+#define BLACK_IMPLIED_TRACE(...)
+#endif
+
 namespace black {
 
 	inline double
@@ -99,6 +122,58 @@ namespace black {
 		return c*(f*Nd1 - k*Nd2);
 	}
 
+	// Value and greeks of n options, v[i] = black(f[i], sigma[i], k[i], t[i]).
+	// Unlike black the greek arrays, if not null, are set rather than incremented.
+	// Outputs may be the same arrays as inputs since element i is read before it is written.
+	inline void
+	black(std::size_t n, const double* f, const double* sigma, const double* k, const double* t,
+		double* v, double* df = 0, double* ddf = 0, double* ds = 0, double* dt = 0)
+	{
+		for (std::size_t i = 0; i < n; ++i) {
+			double g[4] = {0, 0, 0, 0};
+			double x = black(f[i], sigma[i], k[i], t[i], df ? &g[0] : 0, ddf ? &g[1] : 0, ds ? &g[2] : 0, dt ? &g[3] : 0);
+
+			v[i] = x;
+			if (df) df[i] = g[0];
+			if (ddf) ddf[i] = g[1];
+			if (ds) ds[i] = g[2];
+			if (dt) dt[i] = g[3];
+		}
+	}
+
+	// Value with greeks set rather than incremented.
+	template<class T>
+	inline T
+	greeks(T f, T sigma, T k, T t, T* df = 0, T* ddf = 0, T* ds = 0, T* dt = 0)
+	{
+		if (df) *df = 0;
+		if (ddf) *ddf = 0;
+		if (ds) *ds = 0;
+		if (dt) *dt = 0;
+
+		return black(f, sigma, k, t, df, ddf, ds, dt);
+	}
+
+	// Value of a binary paying 1 if f > k for a call or f < -k for a put.
+	inline double
+	binary(double f, double sigma, double k, double t)
+	{
+		ensure (f >= 0);
+		ensure (sigma >= 0);
+		ensure (t >= 0);
+
+		double c = 1;
+		if (k < 0) {
+			c = -1;
+			k = -k;
+		}
+
+		if (f == 0 || sigma == 0 || t == 0 || k == 0)
+			return 1.*(c*f > c*k);
+
+		return normal_cdf<ooura>(c*d2(f, sigma, k, t));
+	}
+
 	inline double
 	value(double f, double sigma, double k, double t)
 	{
@@ -141,57 +216,93 @@ namespace black {
 		return v;
 	} 
 
-	inline double
-	implied_volatility(double f, double p, double k, double t, double s0, double eps, int max_iteration_count)
+	// status of each implied volatility in a batch
+	enum implied_status {
+		implied_ok = 0,     // solved
+		implied_bounds = 1, // price outside the no arbitrage bounds
+		implied_failed = 2  // solver did not converge
+	};
+
+	// Whether p is strictly between the zero and infinite volatility values of the option with
+	// strike k, negative for a put, so it has an implied volatility.
+	inline bool
+	implied_in_bounds(double f, double p, double k, double t)
+	{
+		double c = k < 0 ? -1 : 1;
+		k = fabs(k);
+
+		return f > 0 && t > 0 && p > std::max(c*(f - k), 0.) && p < (c == 1 ? f : k);
+	}
+
+	// Implied volatility with the result reported as an implied_status instead of through ensure,
+	// so callers that must not throw, and builds where ensure is assert, see every failure.
+	// Bracketing, bisection and Newton-Raphson each stop after max_iteration_count steps.
+	// vol is set only when the status is implied_ok.
+	inline int
+	implied_solve(double f, double p, double k, double t, double s0, double eps, int max_iteration_count, double* vol)
 	{
 		double c = 1, s1, p1;
-		
-//		eps *= p;
-		ensure (eps != 0);
+		BLACK_IMPLIED_TRACE(telemetry::trace trace(f, k, t);)
+
+		// price in 0 - infty vol range
+		if (!implied_in_bounds(f, p, k, t)) {
+			BLACK_IMPLIED_TRACE(trace.done(telemetry::bounds, 0);)
+			return implied_bounds;
+		}
 
 		if (k < 0) {
 			c = -1;
 			k = -k;
 		}
 
-		// ensure price in 0 - infty vol range
-		ensure (t > 0);
-		ensure (p > __max(c*(f - k),0.));
-		ensure ((c == 1 && p < f) || (c == -1 && p < k));
-
 		double p0 = black(f, s0, c*k, t) - p;
 
 		// lucky guess
-		if (fabs(p0) < eps)
-			return s0;
+		if (fabs(p0) < eps) {
+			BLACK_IMPLIED_TRACE(trace.done(telemetry::lucky, p0);)
+			*vol = s0;
+			return implied_ok;
+		}
 
 		// bracket the root
 		double m = 1.4;
 		if (p0 > 0) {
 			s1 = s0/m;
 			p1 = black(f, s1, c*k, t) - p;
-			while (p1 > 0) {
+			BLACK_IMPLIED_TRACE(trace.bracket();)
+			for (int i = 0; p1 > 0; ++i) {
+				if (i >= max_iteration_count)
+					return implied_failed;
 				s0 = s1;
 				p0 = p1;
 				s1 = s0/m;
 				p1 = black(f, s1, c*k, t) - p;
+				BLACK_IMPLIED_TRACE(trace.bracket();)
 			}
 		}
 		else {
 			s1 = s0*m;
 			p1 = black(f, s1, c*k, t) - p;
-			while (p1 < 0) {
+			BLACK_IMPLIED_TRACE(trace.bracket();)
+			for (int i = 0; p1 < 0; ++i) {
+				if (i >= max_iteration_count)
+					return implied_failed;
 				s0 = s1;
 				p0 = p1;
 				s1 = s0*m;
 				p1 = black(f, s1, c*k, t) - p;
+				BLACK_IMPLIED_TRACE(trace.bracket();)
 			}
 		}
 
-		if (fabs(p1) < eps)
-			return s1;
+		if (fabs(p1) < eps) {
+			BLACK_IMPLIED_TRACE(trace.done(telemetry::bracketed, p1);)
+			*vol = s1;
+			return implied_ok;
+		}
 
-		ensure (p0*p1 < 0);
+		if (!(p0*p1 < 0))
+			return implied_failed;
 
 		// polish
 		double ds = 0;
@@ -200,27 +311,33 @@ namespace black {
 
 		// if sigma is too small use bisection
 		if (ds < 1e-4) {
-			while (fabs(p2) > eps) {
+			for (int i = 0; !(fabs(p2) <= eps); ++i) {
+				if (i >= max_iteration_count)
+					return implied_failed;
 				if (p0*p2 < 0) {
 					s1 = s2;
 				}
 				else {
-					ensure (p1*p2 < 0);
+					if (!(p1*p2 < 0))
+						return implied_failed;
 					s0 = s2;
 				}
 				s2 = (s1 + s0)/2;
 				p2 = black(f, s2, c*k, t) - p;
+				BLACK_IMPLIED_TRACE(trace.iteration();)
 			}
 
-			return s2;
+			BLACK_IMPLIED_TRACE(trace.done(telemetry::bisection, p2);)
+			*vol = s2;
+			return implied_ok;
 		}
 
-		// Newton-Raphson
+		// Newton-Raphson, a NaN residual runs out of iterations
 		s0 = s2;
 		p0 = p2;
-		for (int i = 0; fabs(p0) > eps; ++i) {
-			ensure (i < max_iteration_count);
-			ensure (ds != 0);
+		for (int i = 0; !(fabs(p0) <= eps); ++i) {
+			if (i >= max_iteration_count || ds == 0)
+				return implied_failed;
 			
 			s1 = s0 - p0/ds;
 			if (s1 < 0)
@@ -228,9 +345,27 @@ namespace black {
 			ds = 0;
 			s0 = s1;
 			p0 = black(f, s0, c*k, t, 0, 0, &ds) - p;
+			BLACK_IMPLIED_TRACE(trace.iteration();)
 		}
 
-		return s0;
+		BLACK_IMPLIED_TRACE(trace.done(telemetry::newton, p0);)
+		*vol = s0;
+		return implied_ok;
+	}
+
+	inline double
+	implied_volatility(double f, double p, double k, double t, double s0, double eps, int max_iteration_count)
+	{
+		double vol = std::numeric_limits<double>::quiet_NaN();
+		
+//		eps *= p;
+		ensure (eps != 0);
+
+		int s = implied_solve(f, p, k, t, s0, eps, max_iteration_count, &vol);
+		ensure (s != implied_bounds);
+		ensure (s == implied_ok);
+
+		return vol;
 	}
 
 	inline double
@@ -239,6 +374,47 @@ namespace black {
 		return implied_volatility(f, p, k, t, 0.2, 1e-10, 100);
 	}
 
+	// Corrado and Miller 1996, "A note on a simple, accurate formula to compute implied standard deviations",
+	// J. Banking & Finance 20, with forwards and no discounting. Puts use put-call parity.
+	inline double
+	corrado_miller_implied_volatility(double f, double p, double k, double t)
+	{
+		ensure (f > 0);
+		ensure (t > 0);
+		ensure (k != 0);
+
+		if (k < 0) {
+			k = -k;
+			p += f - k;
+		}
+
+		double m = p - (f - k)/2;
+		double d = m*m - (f - k)*(f - k)/M_PI;
+
+		return sqrt(2*M_PI/t)*(m + sqrt(__max(d, 0.)))/(f + k);
+	}
+
+	// Implied volatilities of n options with the same forward and expiration.
+	// Each solve is seeded with the last volatility found, starting from s0.
+	// Failed entries are NaN and status, if not null, gets an implied_status.
+	// vol may be the same array as p.
+	inline void
+	implied_volatility(double f, std::size_t n, const double* p, const double* k, double t, double* vol, int* status = 0, double s0 = 0.2)
+	{
+		BLACK_IMPLIED_TRACE(telemetry::batch batch;)
+
+		for (std::size_t i = 0; i < n; ++i) {
+			double v = std::numeric_limits<double>::quiet_NaN();
+			int s = implied_solve(f, p[i], k[i], t, s0, 1e-10, 100, &v);
+
+			if (s == implied_ok)
+				s0 = v;
+			vol[i] = v;
+			if (status)
+				status[i] = s;
+		}
+	}
+
 	inline double
 	implied_forward(double v, double sigma, double k, double t, double f0, double eps, int max_iteration_count, double thresh)
 	{
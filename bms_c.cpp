@@ -0,0 +1,148 @@
+// bms_c.cpp - C interface to black.h, lkk.h and jr.h. The normalexp functions are in bms_normalexp.cpp.
+#include "bms_c_detail.h"
+#include "black.h"
+#include "lkk.h"
+#ifdef BMS_HAVE_JR
+#include "jr.h"
+#endif
+
+using bms::call;
+
+// black::implied_status values are passed through as bms_status
+static_assert(int(black::implied_bounds) == BMS_DOMAIN && int(black::implied_failed) == BMS_NOT_SOLVED, "status values");
+
+extern "C" int bms_version(void)
+{
+	return 2;
+}
+
+extern "C" const char* bms_status_string(int status)
+{
+	switch (status) {
+	case BMS_OK:
+		return "ok";
+	case BMS_DOMAIN:
+		return "argument outside the domain";
+	case BMS_NOT_SOLVED:
+		return "solver did not converge";
+	case BMS_UNAVAILABLE:
+		return "not built into this library";
+	case BMS_ERROR:
+		return "error";
+	}
+
+	return "unknown status";
+}
+
+extern "C" int bms_black_value(double f, double sigma, double k, double t, double* v)
+{
+	return call([&]() {
+		ensure (v);
+		*v = black::value(f, sigma, k, t);
+	});
+}
+
+extern "C" int bms_black_greeks(double f, double sigma, double k, double t,
+	double* v, double* df, double* ddf, double* ds, double* dt)
+{
+	return call([&]() {
+		ensure (v);
+		*v = black::greeks(f, sigma, k, t, df, ddf, ds, dt);
+	});
+}
+
+extern "C" int bms_black_value_n(size_t n, const double* f, const double* sigma, const double* k, const double* t,
+	double* v)
+{
+	return bms_black_greeks_n(n, f, sigma, k, t, v, 0, 0, 0, 0);
+}
+
+extern "C" int bms_black_greeks_n(size_t n, const double* f, const double* sigma, const double* k, const double* t,
+	double* v, double* df, double* ddf, double* ds, double* dt)
+{
+	return call([&]() {
+		ensure (n == 0 || (f && sigma && k && t && v));
+		black::black(n, f, sigma, k, t, v, df, ddf, ds, dt);
+	});
+}
+
+extern "C" int bms_black_implied_volatility(double f, double p, double k, double t, double* sigma)
+{
+	int s;
+	int status = bms_black_implied_volatility_n(f, 1, &p, &k, t, sigma, &s);
+
+	return status == BMS_OK ? s : status;
+}
+
+extern "C" int bms_black_implied_volatility_n(double f, size_t n, const double* p, const double* k, double t,
+	double* sigma, int* status)
+{
+	return call([&]() {
+		ensure (n == 0 || (p && k && sigma));
+		black::implied_volatility(f, n, p, k, t, sigma, status);
+	});
+}
+
+extern "C" int bms_lkk_pdf(double x, double s, double a, double b, double* y)
+{
+	return bms_lkk_pdf_n(1, &x, s, a, b, y);
+}
+
+extern "C" int bms_lkk_cdf(double x, double s, double a, double b, double* y)
+{
+	return bms_lkk_cdf_n(1, &x, s, a, b, y);
+}
+
+extern "C" int bms_lkk_put(double f, double s, double a, double b, double k, double t, double* p)
+{
+	return bms_lkk_put_n(f, s, a, b, 1, &k, t, p);
+}
+
+extern "C" int bms_lkk_pdf_n(size_t n, const double* x, double s, double a, double b, double* y)
+{
+	return call([&]() {
+		ensure (n == 0 || (x && y));
+		ensure (s*s - a - b > 0);
+		lkk::distribution(s, a, b).pdf(n, x, y);
+	});
+}
+
+extern "C" int bms_lkk_cdf_n(size_t n, const double* x, double s, double a, double b, double* y)
+{
+	return call([&]() {
+		ensure (n == 0 || (x && y));
+		ensure (s*s - a - b > 0);
+		lkk::cdf(n, x, y, s, a, b);
+	});
+}
+
+extern "C" int bms_lkk_put_n(double f, double s, double a, double b, size_t n, const double* k, double t, double* p)
+{
+	return call([&]() {
+		ensure (n == 0 || (k && p));
+		ensure (s*s - a - b > 0);
+		lkk::put(f, s, a, b, n, k, p, t);
+	});
+}
+
+extern "C" int bms_jr_value(double s, double r, double t, double sigma, double k,
+	double dk2, double dk3, double dk4, double* v)
+{
+	return bms_jr_value_n(s, r, t, sigma, 1, &k, dk2, dk3, dk4, v);
+}
+
+extern "C" int bms_jr_value_n(double s, double r, double t, double sigma, size_t n, const double* k,
+	double dk2, double dk3, double dk4, double* v)
+{
+#ifdef BMS_HAVE_JR
+	return call([&]() {
+		ensure (n == 0 || (k && v));
+		for (size_t i = 0; i < n; ++i)
+			v[i] = jr::value(s, r, t, sigma, k[i], dk2, dk3, dk4);
+	});
+#else
+	(void)s; (void)r; (void)t; (void)sigma; (void)n; (void)k; (void)dk2; (void)dk3; (void)dk4; (void)v;
+
+	return BMS_UNAVAILABLE;
+#endif
+}
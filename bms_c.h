@@ -0,0 +1,99 @@
+/* bms_c.h - C interface to the pricing kernels for programs that do not run in Excel.
+   Every function returns a bms_status and outputs are unspecified unless it is BMS_OK, except that the
+   batch implied volatility solves what it can and writes NaN for the rest. Strikes follow the add-in convention:
+   a positive strike is a call and a negative strike is a put. Batch outputs may alias their inputs. */
+#ifndef BMS_C_H
+#define BMS_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(BMS_C_BUILD)
+#    define BMS_API __declspec(dllexport)
+#  else
+#    define BMS_API __declspec(dllimport)
+#  endif
+#else
+#  define BMS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum bms_status {
+	BMS_OK = 0,
+	BMS_DOMAIN = 1,      /* arguments outside the domain of the function */
+	BMS_NOT_SOLVED = 2,  /* an iterative solver did not converge */
+	BMS_UNAVAILABLE = 3, /* the library was built without this function */
+	BMS_ERROR = 4        /* anything else */
+} bms_status;
+
+/* version of this interface, incremented when a function is added */
+BMS_API int bms_version(void);
+/* short description of a status */
+BMS_API const char* bms_status_string(int status);
+
+/* Black forward value with df, ddf, dsigma and dt. Greek pointers may be null. */
+BMS_API int bms_black_value(double f, double sigma, double k, double t, double* v);
+BMS_API int bms_black_greeks(double f, double sigma, double k, double t,
+	double* v, double* df, double* ddf, double* ds, double* dt);
+BMS_API int bms_black_value_n(size_t n, const double* f, const double* sigma, const double* k, const double* t,
+	double* v);
+BMS_API int bms_black_greeks_n(size_t n, const double* f, const double* sigma, const double* k, const double* t,
+	double* v, double* df, double* ddf, double* ds, double* dt);
+
+/* Black implied volatility of price p. The batch version shares f and t, writes NaN for options it
+   cannot solve, and if status is not null sets it to BMS_OK, BMS_DOMAIN or BMS_NOT_SOLVED per option. */
+BMS_API int bms_black_implied_volatility(double f, double p, double k, double t, double* sigma);
+BMS_API int bms_black_implied_volatility_n(double f, size_t n, const double* p, const double* k, double t,
+	double* sigma, int* status);
+
+/* Levy-Khintchine/Kolmogorov distribution with volatility s and jump parameters a and b */
+BMS_API int bms_lkk_pdf(double x, double s, double a, double b, double* y);
+BMS_API int bms_lkk_cdf(double x, double s, double a, double b, double* y);
+BMS_API int bms_lkk_put(double f, double s, double a, double b, double k, double t, double* p);
+BMS_API int bms_lkk_pdf_n(size_t n, const double* x, double s, double a, double b, double* y);
+BMS_API int bms_lkk_cdf_n(size_t n, const double* x, double s, double a, double b, double* y);
+BMS_API int bms_lkk_put_n(double f, double s, double a, double b, size_t n, const double* k, double t, double* p);
+
+/* Jarrow-Rudd value with cumulant adjustments. BMS_UNAVAILABLE unless built with ../fmsdual. */
+BMS_API int bms_jr_value(double s, double r, double t, double sigma, double k,
+	double dk2, double dk3, double dk4, double* v);
+BMS_API int bms_jr_value_n(double s, double r, double t, double sigma, size_t n, const double* k,
+	double dk2, double dk3, double dk4, double* v);
+
+/* Standard normal in the middle with exponential tails beyond a < 0 < b, alpha = -a and beta = b */
+BMS_API int bms_normalexp_pdf(double x, double a, double b, double* y);
+BMS_API int bms_normalexp_cdf(double x, double a, double b, double* y);
+BMS_API int bms_normalexp_inv(double u, double a, double b, double* x);
+BMS_API int bms_normalexp_pdf_n(size_t n, const double* x, double a, double b, double* y);
+BMS_API int bms_normalexp_cdf_n(size_t n, const double* x, double a, double b, double* y);
+BMS_API int bms_normalexp_inv_n(size_t n, const double* u, double a, double b, double* x);
+/* put on s0 exp(sigma sqrt(t) X - sigma^2 t/2) with X normalexp, k > 0 */
+BMS_API int bms_normalexp_put(double s0, double sigma, double k, double t, double a, double b, double* p);
+BMS_API int bms_normalexp_put_n(double s0, double sigma, double t, double a, double b, size_t n, const double* k,
+	double* p);
+
+/* Call counts and latencies of the functions timed with BMS_STATS_SCOPE in stats.h. Only functions
+   built with BMS_STATS are timed, so the count is 0 otherwise. */
+typedef struct bms_stats_entry {
+	const char* name;
+	uint64_t calls;
+	double seconds; /* total */
+	double mean, p50, p99, max;
+} bms_stats_entry;
+
+/* number of instrumented functions called so far */
+BMS_API size_t bms_stats_count(void);
+/* fill e for function i < bms_stats_count() in order of first call, return 0 on success */
+BMS_API int bms_stats_get(size_t i, bms_stats_entry* e);
+/* zero all counts */
+BMS_API void bms_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BMS_C_H */
@@ -0,0 +1,32 @@
+// bms_c_detail.h - shared by the translation units of the C interface. Include before the kernels.
+#pragma once
+#include <exception>
+#include <stdexcept>
+#include "bms_c.h"
+
+// failed preconditions become BMS_DOMAIN instead of aborting the caller
+#ifdef ensure
+#undef ensure
+#endif
+#define ensure(e) do { if (!(e)) throw std::domain_error("ensure: " #e); } while (0)
+
+namespace bms {
+
+	// status of calling f, exceptions never cross the C interface
+	template<class F>
+	inline int call(F f)
+	{
+		try {
+			f();
+		}
+		catch (const std::domain_error&) {
+			return BMS_DOMAIN;
+		}
+		catch (...) {
+			return BMS_ERROR;
+		}
+
+		return BMS_OK;
+	}
+
+} // namespace bms
@@ -0,0 +1,70 @@
+// bms_normalexp.cpp - C interface to normalexp.h and putPricer.h from the jiejie branch.
+// These include the branch copy of normal.h, so they live apart from bms_c.cpp.
+#include "bms_c_detail.h"
+#include "branches/jiejie/normalexp.h"
+#include "branches/jiejie/XlltestProj/putPricer.h"
+
+using bms::call;
+
+extern "C" int bms_normalexp_pdf(double x, double a, double b, double* y)
+{
+	return bms_normalexp_pdf_n(1, &x, a, b, y);
+}
+
+extern "C" int bms_normalexp_cdf(double x, double a, double b, double* y)
+{
+	return bms_normalexp_cdf_n(1, &x, a, b, y);
+}
+
+extern "C" int bms_normalexp_inv(double u, double a, double b, double* x)
+{
+	return bms_normalexp_inv_n(1, &u, a, b, x);
+}
+
+extern "C" int bms_normalexp_pdf_n(size_t n, const double* x, double a, double b, double* y)
+{
+	return call([&]() {
+		ensure (n == 0 || (x && y));
+		ensure (a < 0 && b > 0);
+		normalexp(a, -a, b, b).pdf(n, x, y);
+	});
+}
+
+extern "C" int bms_normalexp_cdf_n(size_t n, const double* x, double a, double b, double* y)
+{
+	return call([&]() {
+		ensure (n == 0 || (x && y));
+		ensure (a < 0 && b > 0);
+		normalexp(a, -a, b, b).cdf(n, x, y);
+	});
+}
+
+extern "C" int bms_normalexp_inv_n(size_t n, const double* u, double a, double b, double* x)
+{
+	return call([&]() {
+		ensure (n == 0 || (u && x));
+		ensure (a < 0 && b > 0);
+		for (size_t i = 0; i < n; ++i)
+			ensure (0 < u[i] && u[i] < 1);
+		normalexp_inv(n, u, x, a, -a, b, b);
+	});
+}
+
+extern "C" int bms_normalexp_put(double s0, double sigma, double k, double t, double a, double b, double* p)
+{
+	return bms_normalexp_put_n(s0, sigma, t, a, b, 1, &k, p);
+}
+
+extern "C" int bms_normalexp_put_n(double s0, double sigma, double t, double a, double b, size_t n, const double* k,
+	double* p)
+{
+	return call([&]() {
+		ensure (n == 0 || (k && p));
+		ensure (n <= static_cast<size_t>(std::numeric_limits<int>::max()));
+		ensure (s0 > 0 && sigma > 0 && t > 0);
+		ensure (a < 0 && b > 0);
+		for (size_t i = 0; i < n; ++i)
+			ensure (k[i] > 0);
+		putChain(s0, sigma, t, a, b, static_cast<int>(n), k, p);
+	});
+}
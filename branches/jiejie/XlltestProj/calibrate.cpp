@@ -0,0 +1,142 @@
+// calibrate.cpp - Levenberg-Marquardt fit of normalexp parameters to put prices
+#include <cmath>
+#include "calibrate.h"
+#include "putPricer.h"
+
+// sum of squared residuals, residuals r and Jacobian J (n x 3, row major)
+static double residuals(const normalexpQuotes& q, const normalexpParams& p, double* r, double* J)
+{
+	double cost = 0;
+
+	for (size_t i = 0; i < q.k.size(); ++i) {
+		r[i] = putGradient(q.s0, p.sigma, q.k[i], q.t, p.a, p.b, J + 3*i) - q.put[i];
+		cost += r[i]*r[i];
+	}
+
+	return cost;
+}
+
+// solve the 3 x 3 symmetric positive definite system A x = y by Cholesky
+static bool solve3(double A[3][3], const double y[3], double x[3])
+{
+	double L[3][3] = {{0}};
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j <= i; ++j) {
+			double s = A[i][j];
+			for (int l = 0; l < j; ++l)
+				s -= L[i][l]*L[j][l];
+			if (i == j) {
+				if (!(s > 0))
+					return false;
+				L[i][i] = sqrt(s);
+			}
+			else {
+				L[i][j] = s/L[j][j];
+			}
+		}
+	}
+
+	double z[3];
+	for (int i = 0; i < 3; ++i) {
+		z[i] = y[i];
+		for (int l = 0; l < i; ++l)
+			z[i] -= L[i][l]*z[l];
+		z[i] /= L[i][i];
+	}
+	for (int i = 2; i >= 0; --i) {
+		x[i] = z[i];
+		for (int l = i + 1; l < 3; ++l)
+			x[i] -= L[l][i]*x[l];
+		x[i] /= L[i][i];
+	}
+
+	return true;
+}
+
+int calibrate(const normalexpQuotes& q, normalexpParams& p, int maxIter, double tol)
+{
+	size_t n = q.k.size();
+	if (n < 3 || q.put.size() != n)
+		return -1;
+
+	std::vector<double> r(n), J(3*n), r_(n), J_(3*n);
+	double cost = residuals(q, p, &r[0], &J[0]);
+	double lambda = 1e-3;
+
+	int iter;
+	for (iter = 0; iter < maxIter; ++iter) {
+		double A[3][3] = {{0}}, g[3] = {0};
+		for (size_t i = 0; i < n; ++i) {
+			const double* Ji = &J[3*i];
+			for (int j = 0; j < 3; ++j) {
+				g[j] -= Ji[j]*r[i];
+				for (int l = 0; l <= j; ++l)
+					A[j][l] += Ji[j]*Ji[l];
+			}
+		}
+		for (int j = 0; j < 3; ++j)
+			for (int l = j + 1; l < 3; ++l)
+				A[j][l] = A[l][j];
+
+		// increase the damping until the step stays in sigma > 0, a < 0 < b and reduces the cost
+		bool accepted = false;
+		double d[3];
+		normalexpParams p_;
+		double cost_ = cost;
+		while (!accepted && lambda < 1e16) {
+			double B[3][3];
+			for (int j = 0; j < 3; ++j)
+				for (int l = 0; l < 3; ++l)
+					B[j][l] = A[j][l] + (j == l ? lambda*(A[j][j] + 1e-300) : 0);
+
+			if (solve3(B, g, d)) {
+				p_.sigma = p.sigma + d[0];
+				p_.a = p.a + d[1];
+				p_.b = p.b + d[2];
+				if (p_.sigma > 0 && p_.a < 0 && p_.b > 0) {
+					cost_ = residuals(q, p_, &r_[0], &J_[0]);
+					accepted = cost_ < cost;
+				}
+			}
+			if (!accepted)
+				lambda *= 10;
+		}
+		if (!accepted)
+			break;
+
+		p = p_;
+		r.swap(r_);
+		J.swap(J_);
+		lambda = lambda > 1e-12 ? lambda/10 : lambda;
+
+		bool small = fabs(d[0]) <= tol*(1 + fabs(p.sigma)) && fabs(d[1]) <= tol*(1 + fabs(p.a)) && fabs(d[2]) <= tol*(1 + fabs(p.b));
+		if (small || cost - cost_ <= tol*cost) {
+			cost = cost_;
+			++iter;
+			break;
+		}
+		cost = cost_;
+	}
+
+	return iter;
+}
+
+void calibrateSurface(const std::vector<normalexpQuotes>& q, std::vector<normalexpParams>& p, std::vector<int>* iterations, const normalexpRunner& run)
+{
+	p.resize(q.size());
+	if (iterations)
+		iterations->resize(q.size());
+
+	std::function<void(std::size_t)> f = [&](std::size_t i) {
+		int n = calibrate(q[i], p[i]);
+		if (iterations)
+			(*iterations)[i] = n;
+	};
+
+	if (run)
+		run(q.size(), f);
+	else
+		for (std::size_t i = 0; i < q.size(); ++i)
+			f(i);
+}
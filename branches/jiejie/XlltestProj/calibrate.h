@@ -0,0 +1,29 @@
+// calibrate.h - fit normalexp parameters to put prices
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// parameters of putPricer for one expiry
+struct normalexpParams {
+	double sigma, a, b;
+};
+
+// put prices for one expiry
+struct normalexpQuotes {
+	double s0, t;
+	std::vector<double> k, put;
+};
+
+// Levenberg-Marquardt least squares fit of (sigma, a, b) to the put prices using the analytic
+// gradient from putGradient. p is the starting point, e.g. the previous day's fit, and gets the result.
+// Returns the number of iterations or -1 if there are fewer quotes than parameters.
+int calibrate(const normalexpQuotes& q, normalexpParams& p, int maxIter = 50, double tol = 1e-12);
+
+// run(n, f) calls f(0), ..., f(n - 1) and returns when all are done, possibly concurrently,
+// e.g. [&pool](std::size_t n, const std::function<void(std::size_t)>& f) { pool.run(n, f); }
+typedef std::function<void(std::size_t, const std::function<void(std::size_t)>&)> normalexpRunner;
+
+// calibrate every expiry, in order unless run is given, p is warm started as in calibrate
+// and iterations gets the iteration counts
+void calibrateSurface(const std::vector<normalexpQuotes>& q, std::vector<normalexpParams>& p, std::vector<int>* iterations = 0, const normalexpRunner& run = normalexpRunner());
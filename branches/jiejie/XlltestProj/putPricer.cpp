@@ -23,32 +23,127 @@
 #include "putPricer.h"
 using namespace std;
 
-double putPricer(double s0, double sigma,double k,double t,double a,double b);
+//% With g the unnormalized phiTilda, G0(L) = integral[L, -inf] g(z) dz and G1(L) = integral[L, -inf] exp(sqrt_v*z) g(z) dz
+//% the put is lamda*( k*G0(L) - exp(m)*G1(L) ). Both are sums of a left tail, body and right tail piece
+//% evaluated at min(L,a), L clamped to [a,b] and max(L,b), so every strike uses the same branch free formula.
+//% Calls come from parity with the forward lamda*exp(m)*G1(inf).
 
+double putPricer(double s0, double sigma,double k,double t,double a,double b, putPricerSink sink){
 
-double putPricer(double s0, double sigma,double k,double t,double a,double b){
+	double p;
+
+	putChain(s0, sigma, t, a, b, 1, &k, &p, 0, sink);
+
+	return p;
+}
+
+void putChain(double s0, double sigma, double t, double a, double b, int n, const double* k, double* put, double* call, putPricerSink sink){
 
-	
     double m = log(s0) - .5 * sigma*sigma*t;
     double v = sigma*sigma*t;                      // v is the variance of the Xt distribution
     double sqrt_v = sqrt(v);
     double phi_a = normal_pdf(a);
     double phi_b = normal_pdf(b);
+    double N_a = normal_cdf<ooura>(a);
+    double N_b = normal_cdf<ooura>(b);
+
+	double lamda = 1/( phi_a/-a + N_b - N_a + phi_b/b );  // lamda is the scaling factor to make the modified standard normal distribution integrate to one
+	if (sink)
+		sink("lamda", lamda);
+
+    // coefficients of G0 and exp(m)*G1 for the three pieces
+    // the right tail of G1 is C1*E_b*( exp(c*(Lb-b)) - 1 )/c with c = sqrt_v - b, which tends to C1*E_b*(Lb-b)
+    // as c -> 0, so it is computed with expm1 and the limit taken when sqrt_v == b
+    double A0 = phi_a/-a, C0 = phi_b/b;
+    double A1 = phi_a*exp(m + a*a)/( sqrt_v -a), B1 = exp(m+v/2), C1 = phi_b*exp(m + b*b);
+    double c_b = sqrt_v - b, N_as = normal_cdf<ooura>(a-sqrt_v), E_b = exp( c_b*b );
+
+    for (int i = 0; i < n; ++i) {
+        double L = (log(k[i]) - m)/sqrt_v;    // L is normalized right limit of integration (k normalized to log k to L)
+        double La = L < a ? L : a, Lb = L > b ? L : b, Lm = L < a ? a : L > b ? b : L;
 
-	double lamda = 1/( phi_a/-a + normal_cdf<ooura>(b) - normal_cdf<ooura>(a) + phi_b/b );  // lamda is the scaling factor to make the modified standard normal distribution integrate to one
-	cout << "\n\t lamda, the scaling function is " << lamda <<endl;
+        double G0 = A0*exp( -a*(La-a) ) + normal_cdf<ooura>(Lm) - N_a + C0*( 1 - exp( -b*(Lb-b) ) );
+        double R1 = c_b ? expm1( c_b*(Lb-b) )/c_b : Lb-b;
+        double G1 = A1*exp( (sqrt_v -a)*La ) + B1*( normal_cdf<ooura>(Lm-sqrt_v) - N_as ) + C1*E_b*R1;
 
-    double L = (log(k) - m)/sqrt_v;           // L is normalized right limit of integration (k normalized to log k to L)
+        put[i] = lamda*( k[i]*G0 - G1 );
+    }
 
+    if (call) {
+        double f = lamda*( A1*exp( (sqrt_v -a)*a ) + B1*( normal_cdf<ooura>(b-sqrt_v) - N_as ) - C1*E_b/c_b );
+        if (sink)
+            sink("forward", f);
 
-    if (L <= a)
-        return (lamda*phi_a* (  k*exp(-a*(L-a))/-a - exp( (sqrt_v -a)*L +m+a*a )/( sqrt_v -a) ));
-    else if (L <= b)
-        return (lamda*phi_a* (  k/-a - exp( (sqrt_v -a)*a +m+a*a )/( sqrt_v -a) ) + k*( normal_cdf<ooura>(L) - normal_cdf<ooura>(a) )  - exp(m+v/2)*( normal_cdf<ooura>(L-sqrt_v) - normal_cdf<ooura>(a-sqrt_v) ));
-    else {
-        double A = phi_a* (  k/-a - exp( (sqrt_v -a)*a +m+a*a )/( sqrt_v -a) );
-        double B = k*( normal_cdf<ooura>(b) - normal_cdf<ooura>(a) )  - exp(m+v/2)*( normal_cdf<ooura>(b-sqrt_v) - normal_cdf<ooura>(a-sqrt_v) );
-        double C = phi_b* (  k*(exp(-b*(L-b)) -1)/-b - (exp( (sqrt_v -b)*L +m+b*b )  - exp(b*sqrt_v + m ) )/( sqrt_v -b) );
-        return (lamda*(A+B+C));
+        for (int i = 0; i < n; ++i)
+            call[i] = put[i] + f - k[i];
     }
  }
+
+//% Derivatives of the put. The integrand vanishes at z = L so L can be held fixed.
+//% d/dsigma only moves m and sqrt_v: dG1/dsqrt_v = H1(L) = integral[L, -inf] z*exp(sqrt_v*z) g(z) dz.
+//% g is continuous at a and b so only the tails move with a and b: d/da g(z) = (a - z) g(z) for z < a
+//% and d/db g(z) = (b - z) g(z) for z > b. The normalizer 1/lamda has derivatives phi_a/a^2 and -phi_b/b^2.
+
+// integral[hi, lo] of exp(c*z) and z*exp(c*z), lo may be -inf when c > 0
+// When c*z is small on [lo, hi] the closed forms cancel, so the Taylor series of exp(c*z) is integrated
+// instead. It is exact at c = 0, where I0 = hi - lo and I1 = (hi^2 - lo^2)/2.
+static void expMoments(double c, double lo, double hi, double* I0, double* I1)
+{
+    if (lo != -HUGE_VAL && fabs(c)*(fabs(lo) > fabs(hi) ? fabs(lo) : fabs(hi)) < 1e-2) {
+        double t = 1, l = lo, h = hi;  // c^j/j!, lo^(j+1), hi^(j+1)
+
+        *I0 = *I1 = 0;
+        for (int j = 0; j < 8; ++j) {
+            *I0 += t*(h - l)/(j + 1);
+            l *= lo;
+            h *= hi;
+            *I1 += t*(h - l)/(j + 2);
+            t *= c/(j + 1);
+        }
+
+        return;
+    }
+
+    double Ehi = exp(c*hi), Elo = lo == -HUGE_VAL ? 0 : exp(c*lo);
+
+    *I0 = (Ehi - Elo)/c;
+    *I1 = Ehi*(hi/c - 1/(c*c)) - (Elo ? Elo*(lo/c - 1/(c*c)) : 0);
+}
+
+double putGradient(double s0, double sigma, double k, double t, double a, double b, double* g){
+
+    double sqrt_t = sqrt(t);
+    double sqrt_v = sigma*sqrt_t;
+    double m = log(s0) - .5 * sqrt_v*sqrt_v;
+    double phi_a = normal_pdf(a);
+    double phi_b = normal_pdf(b);
+    double Z = phi_a/-a + normal_cdf<ooura>(b) - normal_cdf<ooura>(a) + phi_b/b;  // 1/lamda
+
+    double L = (log(k) - m)/sqrt_v;
+    double La = L < a ? L : a, Lb = L > b ? L : b, Lm = L < a ? a : L > b ? b : L;
+
+    // left tail g(z) = Ka exp(-a*z), right tail g(z) = Kb exp(-b*z)
+    double Ka = phi_a*exp(a*a), Kb = phi_b*exp(b*b);
+    double GL0, HL0, GL1, HL1, GR0, HR0, GR1, HR1;
+    expMoments(-a, -HUGE_VAL, La, &GL0, &HL0);
+    expMoments(sqrt_v -a, -HUGE_VAL, La, &GL1, &HL1);
+    expMoments(-b, b, Lb, &GR0, &HR0);
+    expMoments(sqrt_v -b, b, Lb, &GR1, &HR1);
+
+    double E = exp(.5*sqrt_v*sqrt_v);
+    double GM0 = normal_cdf<ooura>(Lm) - normal_cdf<ooura>(a);
+    double GM1 = E*( normal_cdf<ooura>(Lm-sqrt_v) - normal_cdf<ooura>(a-sqrt_v) );
+    double HM1 = sqrt_v*GM1 - E*( normal_pdf(Lm-sqrt_v) - normal_pdf(a-sqrt_v) );
+
+    double G0 = Ka*GL0 + GM0 + Kb*GR0;
+    double G1 = Ka*GL1 + GM1 + Kb*GR1;
+    double H1 = Ka*HL1 + HM1 + Kb*HR1;
+    double em = exp(m);
+    double N = k*G0 - em*G1;  // put/lamda
+
+    g[0] = -em*( -sqrt_v*sqrt_t*G1 + sqrt_t*H1 )/Z;
+    g[1] = ( k*Ka*(a*GL0 - HL0) - em*Ka*(a*GL1 - HL1) )/Z - N*(phi_a/(a*a))/(Z*Z);
+    g[2] = ( k*Kb*(b*GR0 - HR0) - em*Kb*(b*GR1 - HR1) )/Z + N*(phi_b/(b*b))/(Z*Z);
+
+    return N/Z;
+}
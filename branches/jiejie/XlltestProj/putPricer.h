@@ -1,6 +1,14 @@
 
-#include <iostream>
 #include <math.h>
-using namespace std;
 
-double putPricer(double s0, double sigma,double k,double t,double a,double b);
+// optional diagnostics sink, called with the name and value of intermediate results
+typedef void (*putPricerSink)(const char* name, double value);
+
+double putPricer(double s0, double sigma,double k,double t,double a,double b, putPricerSink sink = 0);
+
+// put and call prices for n strikes, the terms that depend only on (s0, sigma, t, a, b) are computed once
+// call may be 0, calls need sigma*sqrt(t) < b for the forward to be finite
+void putChain(double s0, double sigma, double t, double a, double b, int n, const double* k, double* put, double* call = 0, putPricerSink sink = 0);
+
+// put price and its derivatives g[0] = dput/dsigma, g[1] = dput/da, g[2] = dput/db
+double putGradient(double s0, double sigma, double k, double t, double a, double b, double* g);
@@ -3,69 +3,72 @@
 #pragma once
 #include <cmath>
 #include <functional>
+#include <limits>
 #include <boost/math/distributions/normal.hpp>
 #include <boost/math/tools/roots.hpp>
 
 using boost::math::detail::check_positive_x;
 using boost::math::tools::bracket_and_solve_root;
+using boost::math::tools::halley_iterate;
 
 template<class T = double, class Policy = boost::math::policies::policy<>>
 class black {
 public:
-	// Not so efficient calculations for greeks.
+	// Strike and expiration of an option. The member functions only read k and t so
+	// options can be shared between threads.
 	struct black_data {
 		T k;
 		T t;
-		mutable T srt_; // sigma*sqrt(t)
-		mutable T d1_;
-		mutable T d2_;
-		mutable T Nd1_;
-		mutable T Nd2_;
-		mutable T nd1_;
 		black_data(T strike, T expiration)
-			: k(strike), t(expiration), srt_(0), d1_(0), d2_(0), Nd1_(0), Nd2_(0), nd1_(0)
-		{ 
-
-		}
+			: k(strike), t(expiration)
+		{ }
 		T srt(T volatility) const
 		{
 			return volatility*sqrt(t);
 		}
 		T d1(T forward, T volatility) const
 		{
-			srt_ = srt(volatility);
+			T srt_ = srt(volatility);
 
-			d1_ = log(forward/k)/srt_ + srt_/2;
-			d2_ = d1_ - srt_;
-
-			return d1_;
+			return log(forward/k)/srt_ + srt_/2;
 		}
 		T d2(T forward, T volatility) const
 		{
-			d1_ = d1(forward, volatility);
-
-			return d2_;
+			return d1(forward, volatility) - srt(volatility);
 		}
 		T Nd1(T forward, T volatility) const
 		{
-			Nd1_ = cdf(boost::math::normal_distribution<T>(), d1(forward, volatility));
-
-			return Nd1_;
+			return cdf(boost::math::normal_distribution<T>(), d1(forward, volatility));
 		}
 		T Nd2(T forward, T volatility) const
 		{
-			Nd2_ = cdf(boost::math::normal_distribution<T>(), d2(forward, volatility));
-
-			return Nd2_;
+			return cdf(boost::math::normal_distribution<T>(), d2(forward, volatility));
 		}
 		T nd1(T forward, T volatility) const
 		{
-			nd1_ = pdf(boost::math::normal_distribution<T>(), d1(forward, volatility));
-
-			return nd1_;
+			return pdf(boost::math::normal_distribution<T>(), d1(forward, volatility));
 		}
 	};
 
+	// Everything the value and greeks need from (forward, volatility), computed once.
+	// The members are const so a state can be copied and shared between pricing threads.
+	struct state {
+		const T srt; // sigma*sqrt(t)
+		const T d1;
+		const T d2;
+		const T Nd1;
+		const T Nd2;
+		const T nd1;
+		state(const black_data& o, T forward, T volatility)
+			: srt(o.srt(volatility)),
+			  d1(log(forward/o.k)/srt + srt/2),
+			  d2(d1 - srt),
+			  Nd1(cdf(boost::math::normal_distribution<T>(), d1)),
+			  Nd2(cdf(boost::math::normal_distribution<T>(), d2)),
+			  nd1(pdf(boost::math::normal_distribution<T>(), d1))
+		{ }
+	};
+
 	struct option : public black::black_data { 
 		option(T strike, T expiration)
 			: black::black_data(strike, expiration)
@@ -84,13 +87,10 @@ public:
 	// cp > 0 for calls, cp < 0 for puts
 	// the values pointed to by the greeks get incremented
 	// cp can be different than 1 or -1 to calculate weighted portfolios
-	template<class O>
-	static T greeks(const O& o, T cp, T forward, T volatility,
-		T* delta = 0, T* gamma = 0, T* vega = 0, T* theta = 0);
+	// Each kind of option is an overload, explicit specializations at class scope only build with MSVC.
 
 	// European call or put option.
-	template<>
-	static T greeks<option>(const option& o, T cp, T f, T sigma, T* df, T* ddf, T* ds, T* dt)
+	static T greeks(const option& o, T cp, T f, T sigma, T* df = 0, T* ddf = 0, T* ds = 0, T* dt = 0)
 	{
 		// boundary cases
 		if (f == 0 || sigma == 0 || o.t == 0) {
@@ -106,41 +106,43 @@ public:
 		}
 
 		T result;
-		if (!check_positive_x(__FUNCTION__ "%1%", f, &result, Policy()))
+		if (!check_positive_x("black<%1%>::greeks", f, &result, Policy()))
 			return result;
-		if (!check_positive_x(__FUNCTION__ "%1%", sigma, &result, Policy()))
+		if (!check_positive_x("black<%1%>::greeks", sigma, &result, Policy()))
 			return result;
-		if (!check_positive_x(__FUNCTION__ "%1%", o.t, &result, Policy()))
+		if (!check_positive_x("black<%1%>::greeks", o.t, &result, Policy()))
 			return result;
 
+		return greeks(o, state(o, f, sigma), cp, f, sigma, df, ddf, ds, dt);
+	}
+
+	// European call or put option greeks from an evaluated state for (f, sigma).
+	static T greeks(const option& o, const state& s, T cp, T f, T sigma,
+		T* df = 0, T* ddf = 0, T* ds = 0, T* dt = 0)
+	{
 		if (df)
-			*df += cp*o.Nd1(f, sigma);
+			*df += cp*s.Nd1;
 
 		if (ddf)
-			*ddf += o.nd1(f, sigma)/(f*o.srt(sigma));
+			*ddf += s.nd1/(f*s.srt);
 
 		if (ds)
-			*ds += f*o.srt(sigma)*o.nd1(f, sigma)/sigma;
+			*ds += f*s.srt*s.nd1/sigma;
 
 		if (dt)
-			*dt += -f*o.srt(sigma)*o.nd1(f, sigma)/(2*o.t);
+			*dt += -f*s.srt*s.nd1/(2*o.t);
 
-		return cp*(f*o.Nd1(f, sigma) - o.k*o.Nd2(f, sigma));
+		return cp*(f*s.Nd1 - o.k*s.Nd2);
 	}
 
-	template<class O>
-	static T value(const O& o, T cp, T forward, T volatility);
-
 	// European call or put option.
-	template<>
-	static T value<option>(const option& o, T cp, T f, T sigma)
+	static T value(const option& o, T cp, T f, T sigma)
 	{
 		return greeks(o, cp, f, sigma);
 	}
 
 	// European binary call or put.
-	//template<>
-	//static T greeks<binary>(const option& o, T cp, T f, T sigma, T* df, T* ddf, T* ds, T* dt)
+	//static T greeks(const binary& o, T cp, T f, T sigma, T* df = 0, T* ddf = 0, T* ds = 0, T* dt = 0)
 
 	// European call or put implied volatility
 	template<class O, class Tol>
@@ -153,6 +155,28 @@ public:
 
 		return mid(v);
 	}
+
+	// European call or put implied volatility using Halley steps fed by the analytic vega and volga.
+	// Boost's halley_iterate falls back to bisection whenever a step would leave [lo, hi].
+	// max_iter is the iteration limit on entry and the number of iterations used on exit.
+	template<class O>
+	static T implied_halley(const O& o, T cp, T forward, T price, T guess, T lo, T hi, int digits, boost::uintmax_t& max_iter)
+	{
+		return halley_iterate([&](T sigma) -> boost::math::tuple<T,T,T> {
+				state s(o, forward, sigma);
+				T vega(0);
+				T v = greeks(o, s, cp, forward, sigma, 0, 0, &vega);
+				vega *= cp;
+
+				return boost::math::make_tuple(v - price, vega, vega*s.d1*s.d2/sigma); // volga = vega d1 d2/sigma
+			}, guess, lo, hi, digits, max_iter);
+	}
+	// Halley implied volatility in (0, 10) to half the digits of T.
+	template<class O>
+	static T implied_halley(const O& o, T cp, T forward, T price, T guess, boost::uintmax_t& max_iter)
+	{
+		return implied_halley(o, cp, forward, price, guess, std::numeric_limits<T>::min(), T(10), std::numeric_limits<T>::digits/2, max_iter);
+	}
 private:
 	static T mid(const std::pair<T,T>& p)
 	{
@@ -1,5 +1,6 @@
 // normalexp.h - normal in the middle, exponential at both ends
 #pragma once
+#include <cstddef>
 #include "normal.h"
 
 #pragma warning(push)
@@ -58,7 +59,7 @@ double normalexp_exp(double x, double sigma, double a, double alpha, double b, d
 		ans = ans/normalexp_den(a,alpha,b,beta);
 	}
 	else {
-		ans = normal_pdf(a)/(sigma-a);
+		ans = normal_pdf(a)*exp(a*sigma)/(sigma-a);
 		ans = ans + exp(.5*sigma*sigma)*(normal_cdf<ooura>(b-sigma) - normal_cdf<ooura>(a-sigma));
 		ans = ans + normal_pdf(b)*(exp((sigma-b)*x + b*b)  - exp(sigma*b))/(sigma-b);
 		ans = ans/normalexp_den(a,alpha,b,beta);
@@ -66,6 +67,130 @@ double normalexp_exp(double x, double sigma, double a, double alpha, double b, d
 	return ans;
 }
 
+// Normal with exponential tails with the normalizer and tail constants computed once per parameter set.
+// The array members evaluate the left tail, body and right tail at clamped arguments and add
+// or select the pieces, so one formula covers every region.
+// assumptions: a<0<b and a = -alpha and b = beta
+class normalexp {
+	double a_, b_;
+	double phi_a_, phi_b_; // normal_pdf(a), normal_pdf(b)
+	double N_a_;           // normal_cdf<ooura>(a)
+	double ma_, mb_;       // left and right tail areas, -phi(a)/a and phi(b)/b
+	double den_;           // normalexp_den
+public:
+	normalexp(double a, double alpha, double b, double beta)
+		: a_(a), b_(b), phi_a_(normal_pdf(a)), phi_b_(normal_pdf(b)), N_a_(normal_cdf<ooura>(a))
+	{
+		ma_ = -phi_a_/a;
+		mb_ = phi_b_/b;
+		den_ = ma_ + normal_cdf<ooura>(b) - N_a_ + mb_;
+	}
+
+	double den(void) const
+	{
+		return den_;
+	}
+
+	double pdf(double x) const
+	{
+		return (x < a_ ? phi_a_*exp(-a_*(x - a_)) : x < b_ ? normal_pdf(x) : phi_b_*exp(-b_*(x - b_)))/den_;
+	}
+	double cdf(double x) const
+	{
+		return (x < a_ ? ma_*exp(-a_*(x - a_))
+			: x < b_ ? ma_ + normal_cdf<ooura>(x) - N_a_
+			: den_ - mb_*exp(-b_*(x - b_)))/den_;
+	}
+	// integral to x of exp(sigma x)h(x) dx, sigma < b
+	double cdf_exp(double x, double sigma) const
+	{
+		double y = sigma*sigma/2;
+
+		if (x < a_)
+			return phi_a_*exp((sigma - a_)*x + a_*a_)/((sigma - a_)*den_);
+
+		y = phi_a_*exp(a_*sigma)/(sigma - a_) + exp(y)*(normal_cdf<ooura>((x < b_ ? x : b_) - sigma) - normal_cdf<ooura>(a_ - sigma));
+		if (x >= b_)
+			y += phi_b_*(exp((sigma - b_)*x + b_*b_) - exp(sigma*b_))/(sigma - b_);
+
+		return y/den_;
+	}
+
+	// y[i] = pdf(x[i]), x and y may be the same array
+	void pdf(std::size_t n, const double* x, double* y) const
+	{
+		const double a = a_, b = b_, phi_a = phi_a_, phi_b = phi_b_, r = 1/den_;
+
+		for (std::size_t i = 0; i < n; ++i) {
+			double xi = x[i];
+			bool lo = xi < a, hi = xi >= b;
+			double xm = lo ? a : hi ? b : xi;
+			double ya = phi_a*exp(-a*((lo ? xi : a) - a));
+			double yb = phi_b*exp(-b*((hi ? xi : b) - b));
+			y[i] = r*(lo ? ya : hi ? yb : normal_pdf(xm));
+		}
+	}
+	// y[i] = cdf(x[i]), x and y may be the same array
+	// cdf(x) = (left(min(x, a)) + N(clamp(x, a, b)) - N(a) + right(max(x, b)))/den
+	void cdf(std::size_t n, const double* x, double* y) const
+	{
+		const double a = a_, b = b_, ma = ma_, mb = mb_, N_a = N_a_, r = 1/den_;
+
+		for (std::size_t i = 0; i < n; ++i) {
+			double xi = x[i];
+			double xa = xi < a ? xi : a, xb = xi > b ? xi : b, xm = xi < a ? a : xi > b ? b : xi;
+			y[i] = r*(ma*exp(-a*(xa - a)) + normal_cdf<ooura>(xm) - N_a + mb*(1 - exp(-b*(xb - b))));
+		}
+	}
+	// y[i] = cdf_exp(x[i], sigma), x and y may be the same array
+	void cdf_exp(std::size_t n, const double* x, double* y, double sigma) const
+	{
+		const double a = a_, b = b_, r = 1/den_;
+		const double ca = phi_a_*exp(a*a)/(sigma - a), cb = phi_b_*exp(b*b)/(sigma - b);
+		const double eb = exp(sigma*b - b*b), cm = exp(sigma*sigma/2), N_as = normal_cdf<ooura>(a - sigma);
+
+		for (std::size_t i = 0; i < n; ++i) {
+			double xi = x[i];
+			double xa = xi < a ? xi : a, xb = xi > b ? xi : b, xm = xi < a ? a : xi > b ? b : xi;
+			y[i] = r*(ca*exp((sigma - a)*xa) + cm*(normal_cdf<ooura>(xm - sigma) - N_as) + cb*(exp((sigma - b)*xb) - eb));
+		}
+	}
+};
+
+// inverse of normalexp_cdf, the exponential tails invert in closed form
+// assumptions: assumption of a<0<b and a = -alpha and b = beta and 0 < u < 1
+inline
+double normalexp_inv(double u, double a, double alpha, double b, double beta)
+{
+	double den = normalexp_den(a,alpha,b,beta);
+	double ans = -1.0;
+	if (u < -normal_pdf(a)/(a*den))
+		ans = a - log( -a*den*u/normal_pdf(a) )/a;
+	else if (u < 1 - normal_pdf(b)/(b*den))
+		ans = normal_inv<ooura>( u*den + normal_pdf(a)/a + normal_cdf<ooura>(a) );
+	else
+		ans = b - log( b*den*(1 - u)/normal_pdf(b) )/b;
+	return ans;
+}
+
+// x[i] = normalexp_inv(u[i], a, alpha, b, beta), u and x may be the same array
+// The constants are computed once and each point evaluates only the piece for its region.
+inline
+void normalexp_inv(std::size_t n, const double* u, double* x, double a, double alpha, double b, double beta)
+{
+	const double den = normalexp_den(a,alpha,b,beta);
+	const double phi_a = normal_pdf(a), phi_b = normal_pdf(b);
+	const double ua = -phi_a/(a*den), ub = 1 - phi_b/(b*den); // cdf at a and b
+	const double ca = -a*den/phi_a, cb = b*den/phi_b, c = phi_a/a + normal_cdf<ooura>(a);
+
+	for (std::size_t i = 0; i < n; ++i) {
+		double ui = u[i];
+		x[i] = ui < ua ? a - log( ca*ui )/a
+		     : ui < ub ? normal_inv<ooura>( ui*den + c )
+		     : b - log( cb*(1 - ui) )/b;
+	}
+}
+
 // If F = f exp(ct + sigma sqrt(t) X), E[max{k - S}, F] = ? normalexp_cdf - ? normalexp_exp
 // Choose c so thate E[S] = f.
 
@@ -0,0 +1,225 @@
+// brownian.h - blocks of standard Brownian motion paths from Sobol points.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "normal.h"
+#include "parallel.h"
+#include "sobol.h"
+#include "statistics.h"
+
+namespace brownian {
+
+	// Brownian bridge construction on times 0 < t_0 < ... < t_{m-1}.
+	// Step 0 sets the terminal value and later steps bisect the ranges of unfilled indices breadth first,
+	// filling the middle index of each range whatever the spacing of the times, so the first Sobol
+	// dimensions, which are the most uniform, set the coarse shape of the path.
+	class bridge {
+		std::vector<double> t_;
+		std::vector<std::size_t> b_, l_, r_; // fill b_[k] from l_[k] and r_[k], m means t = 0
+		std::vector<double> lw_, rw_, sd_;
+	public:
+		explicit bridge(const std::vector<double>& t)
+			: t_(t), b_(t.size()), l_(t.size()), r_(t.size()), lw_(t.size()), rw_(t.size()), sd_(t.size())
+		{
+			std::size_t m = t.size();
+			ensure (m > 0);
+			ensure (t[0] > 0);
+			for (std::size_t j = 1; j < m; ++j)
+				ensure (t[j] > t[j - 1]);
+
+			std::vector<bool> done(m, false);
+			b_[0] = m - 1;
+			l_[0] = r_[0] = m;
+			lw_[0] = rw_[0] = 0;
+			sd_[0] = sqrt(t[m - 1]);
+			done[m - 1] = true;
+
+			// breadth first bisection of [left, right] index ranges
+			std::vector<std::size_t> lo(1, 0), hi(1, m - 1); // unfilled indices lo, ..., hi - 1 before filled hi
+			for (std::size_t k = 1, q = 0; k < m; ++q) {
+				std::size_t a = lo[q], z = hi[q];
+				if (a == z)
+					continue;
+
+				std::size_t i = a + (z - a - 1)/2;
+				double tl = a ? t[a - 1] : 0, ti = t[i], tr = t[z];
+
+				b_[k] = i;
+				l_[k] = a ? a - 1 : m;
+				r_[k] = z;
+				lw_[k] = (tr - ti)/(tr - tl);
+				rw_[k] = (ti - tl)/(tr - tl);
+				sd_[k] = sqrt((ti - tl)*(tr - ti)/(tr - tl));
+				++k;
+
+				lo.push_back(a);
+				hi.push_back(i);
+				lo.push_back(i + 1);
+				hi.push_back(z);
+			}
+		}
+
+		std::size_t size(void) const
+		{
+			return t_.size();
+		}
+		const std::vector<double>& times(void) const
+		{
+			return t_;
+		}
+
+		// w[j*p + i] = W_i(t_j) from standard normals z[k*p + i] for p paths.
+		// Both blocks are step major so each inner loop runs over paths with fixed weights.
+		void operator()(std::size_t p, const double* z, double* w) const
+		{
+			std::size_t m = t_.size();
+
+			for (std::size_t k = 0; k < m; ++k) {
+				double* wb = w + b_[k]*p;
+				const double* zk = z + k*p;
+				double lw = lw_[k], rw = rw_[k], sd = sd_[k];
+
+				if (l_[k] == m && r_[k] == m) {
+					for (std::size_t i = 0; i < p; ++i)
+						wb[i] = sd*zk[i];
+				}
+				else if (l_[k] == m) {
+					const double* wr = w + r_[k]*p;
+					for (std::size_t i = 0; i < p; ++i)
+						wb[i] = rw*wr[i] + sd*zk[i];
+				}
+				else {
+					const double* wl = w + l_[k]*p;
+					const double* wr = w + r_[k]*p;
+					for (std::size_t i = 0; i < p; ++i)
+						wb[i] = lw*wl[i] + rw*wr[i] + sd*zk[i];
+				}
+			}
+		}
+	};
+
+	// Sobol driven path blocks. Path n uses Sobol point n + 1 with dimension k feeding bridge step k.
+	// Dimensions are generated one at a time so a block never needs a row of the point set.
+	class paths {
+		bridge b_;
+		rng::sobol s_;
+	public:
+		explicit paths(const std::vector<double>& t)
+			: b_(t), s_(t.size())
+		{ }
+		// m equal steps to time T
+		paths(std::size_t m, double T)
+			: b_(grid(m, T)), s_(m)
+		{ }
+
+		static std::vector<double> grid(std::size_t m, double T)
+		{
+			ensure (m > 0);
+			ensure (T > 0);
+
+			std::vector<double> t(m);
+			for (std::size_t j = 0; j < m; ++j)
+				t[j] = T*(j + 1)/m;
+
+			return t;
+		}
+
+		std::size_t steps(void) const
+		{
+			return b_.size();
+		}
+		const std::vector<double>& times(void) const
+		{
+			return b_.times();
+		}
+
+		// w[j*p + i] = W_{n + i}(t_j) for p paths starting at path n.
+		// z is scratch of the same size as w.
+		void operator()(std::uint64_t n, std::size_t p, double* w, double* z) const
+		{
+			for (std::size_t k = 0; k < b_.size(); ++k) {
+				s_(k, n + 1, p, z + k*p);
+				normal_inv<ooura>(p, z + k*p, z + k*p);
+			}
+
+			b_(p, z, w);
+		}
+		void operator()(std::uint64_t n, std::size_t p, double* w) const
+		{
+			std::vector<double> z(b_.size()*p);
+
+			operator()(n, p, w, &z[0]);
+		}
+	};
+
+	// Time slices of p paths starting at path n without storing the block.
+	// A bridge needs the terminal value first, so this uses incremental construction:
+	// slice j adds sqrt(t_j - t_{j-1}) times the normals from Sobol dimension j.
+	// Late slices depend on every dimension equally, so they converge more slowly than paths.
+	class stream {
+		std::vector<double> t_;
+		rng::sobol s_;
+		std::uint64_t n_;
+		std::vector<double> w_, z_;
+		std::size_t j_;
+	public:
+		stream(const std::vector<double>& t, std::uint64_t n, std::size_t p)
+			: t_(t), s_(t.size()), n_(n), w_(p, 0.), z_(p), j_(0)
+		{
+			ensure (t.size() > 0);
+		}
+
+		// index of the next slice
+		std::size_t step(void) const
+		{
+			return j_;
+		}
+
+		// W_{n + i}(t_j) for the next j, or 0 after the last time
+		const double* next(void)
+		{
+			if (j_ == t_.size())
+				return 0;
+
+			double sdt = sqrt(t_[j_] - (j_ ? t_[j_ - 1] : 0));
+			std::size_t p = w_.size();
+
+			s_(j_, n_ + 1, p, &z_[0]);
+			normal_inv<ooura>(p, &z_[0], &z_[0]);
+			for (std::size_t i = 0; i < p; ++i)
+				w_[i] += sdt*z_[i];
+			++j_;
+
+			return &w_[0];
+		}
+	};
+
+	// Moments of W(t_j) for each step over n paths, generated in blocks of p paths on the pool.
+	// Block b holds paths b p, ..., and blocks are merged in order so the result does not depend
+	// on the number of threads. The variance of step j should be t_j.
+	inline std::vector<statistics::moments> moments(const paths& w, std::uint64_t n, std::size_t p, parallel::pool& pool)
+	{
+		std::size_t m = w.steps(), blocks = static_cast<std::size_t>((n + p - 1)/p);
+		std::vector<std::vector<statistics::moments> > r(blocks, std::vector<statistics::moments>(m));
+
+		pool.run(blocks, [&](std::size_t b) {
+			std::size_t q = static_cast<std::size_t>(std::min<std::uint64_t>(p, n - b*p));
+			std::vector<double> x(m*q), z(m*q);
+
+			w(b*p, q, &x[0], &z[0]);
+			for (std::size_t j = 0; j < m; ++j)
+				r[b][j].add(q, &x[j*q]);
+		});
+
+		std::vector<statistics::moments> s(m);
+		for (std::size_t b = 0; b < blocks; ++b)
+			for (std::size_t j = 0; j < m; ++j)
+				s[j].merge(r[b][j]);
+
+		return s;
+	}
+
+} // namespace brownian
@@ -0,0 +1,118 @@
+// fft.h - radix-2 fast Fourier transform and Carr-Madan option pricing from a characteristic function.
+// Carr and Madan 1999, "Option valuation using the fast Fourier transform", Journal of Computational Finance 2:61-73.
+#pragma once
+#ifndef ensure
+#include <cassert>
+#define ensure(x) assert(x)
+#endif
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI		3.1415926535897931e+00
+#endif
+
+namespace fft {
+
+	// In place a[m] <- sum_j a[j] exp(-2 pi i jm/n), or exp(+...) if inverse, n a power of 2.
+	inline void radix2(std::complex<double>* a, std::size_t n, bool inverse = false)
+	{
+		ensure (n && (n & (n - 1)) == 0);
+
+		// bit reversal permutation
+		for (std::size_t i = 1, j = 0; i < n; ++i) {
+			std::size_t bit = n >> 1;
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j)
+				std::swap(a[i], a[j]);
+		}
+
+		// butterflies
+		for (std::size_t len = 2; len <= n; len <<= 1) {
+			double theta = (inverse ? 2 : -2)*M_PI/len;
+			std::complex<double> wl(cos(theta), sin(theta));
+			for (std::size_t i = 0; i < n; i += len) {
+				std::complex<double> w(1);
+				for (std::size_t j = 0; j < len/2; ++j) {
+					std::complex<double> u = a[i + j], v = a[i + j + len/2]*w;
+					a[i + j] = u + v;
+					a[i + j + len/2] = u - v;
+					w *= wl;
+				}
+			}
+		}
+	}
+
+	// Call and put values on a grid of n log strikes centered at c with spacing 2 pi/(n eta)
+	// given phi(u) = E[exp(iu log F)] for complex u. Calls use the damping factor exp(alpha k)
+	// and Simpson weights, puts come from put-call parity. The measure need not have mass 1.
+	class carr_madan {
+		double k0_, lambda_;       // first log strike and spacing
+		double mass_, mean_;       // phi(0) = E[1], phi(-i) = E[F]
+		std::vector<double> call_; // call values at log strikes k0 + lambda m
+	public:
+		template<class CF>
+		carr_madan(CF phi, double c, std::size_t n = 4096, double eta = 0.25, double alpha = 1.5)
+			: lambda_(2*M_PI/(n*eta)), call_(n)
+		{
+			typedef std::complex<double> complex;
+			const complex I(0, 1);
+
+			ensure (alpha > 0);
+
+			k0_ = c - n*lambda_/2;
+			mass_ = std::real(phi(complex(0)));
+			mean_ = std::real(phi(-I));
+
+			std::vector<complex> x(n);
+			for (std::size_t j = 0; j < n; ++j) {
+				double u = eta*j;
+				complex psi = phi(u - (alpha + 1)*I)/(alpha*alpha + alpha - u*u + I*(2*alpha + 1)*u);
+				double w = eta/3*(j == 0 ? 1 : j%2 ? 4 : 2);
+
+				x[j] = exp(-I*u*k0_)*psi*w;
+			}
+
+			radix2(&x[0], n);
+
+			for (std::size_t m = 0; m < n; ++m)
+				call_[m] = exp(-alpha*(k0_ + lambda_*m))/M_PI*std::real(x[m]);
+		}
+
+		std::size_t size(void) const
+		{
+			return call_.size();
+		}
+		double log_strike(std::size_t m) const
+		{
+			return k0_ + lambda_*m;
+		}
+
+		// cubic Lagrange interpolation in log strike
+		// Throws rather than using ensure so strikes off the grid are caught in release builds too.
+		double call(double k) const
+		{
+			double x = (log(k) - k0_)/lambda_;
+
+			if (!(x >= 1 && x < call_.size() - 2.))
+				throw std::out_of_range("fft::carr_madan: strike outside the grid");
+
+			std::size_t m = static_cast<std::size_t>(x);
+			x -= m;
+			const double* c = &call_[m - 1];
+
+			return -x*(x - 1)*(x - 2)/6*c[0] + (x + 1)*(x - 1)*(x - 2)/2*c[1]
+			       - (x + 1)*x*(x - 2)/2*c[2] + (x + 1)*x*(x - 1)/6*c[3];
+		}
+		double put(double k) const
+		{
+			return call(k) - mean_ + k*mass_;
+		}
+	};
+
+} // namespace fft
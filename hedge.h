@@ -1,38 +1,251 @@
 // hedge.h - hedging using futures
 #pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <tuple>
-#include "xll/utility/srng.h"
+#include <vector>
+#include "black.h"
 #include "normal.h"
+#include "parallel.h"
+#include "philox.h"
+#include "statistics.h"
 
 namespace hedge {
 
-	// inf {t > 0 : min B_t > lo, max B_t < hi }, hi?
-	inline std::tuple<double,bool> hitting_time(double lo, double hi)
-	{
-		static utility::srng rng; // should use global variable
+	// First exit of standard Brownian motion from (lo, hi), lo < 0 < hi, and the side hit.
+	// Scaled to the unit interval started at x = -lo/(hi - lo) the exit time is tau/w^2, w = hi - lo, and
+	//   P(tau <= t, hi) = sum_k sign(d_k) erfc(|d_k|/sqrt(2t)), d_k = 2k + 1 - x           (images, small t)
+	//                   = x - (2/pi) sum_m (-1)^(m+1) sin(m pi x) exp(-m^2 pi^2 t/2)/m     (Fourier, large t)
+	// so P(hi) = x. The low side is the same with x replaced by 1 - x.
+	// Given the side, the time inverts the conditional distribution. It is tabulated on n cells
+	// and interpolated by cubic Hermite using dt/du = P(side)/pdf(t), with exact inversion in the
+	// outer cells as in lkk::quantile. n = 0 always solves exactly.
+	class exit_time {
+		double w_, x_;
+		std::vector<double> t_[2], dt_[2]; // t_[hi][j] = inverse(j/n, hi) on the unit interval and its derivative
+		std::size_t m_;            // number of exact cells at each end
+
+		// P(tau <= t, exit at 1) and P(tau > t, exit at 1) from x on the unit interval
+		static void unit(double t, double x, double* F, double* S, double* f)
+		{
+			double y = 0, p = 0;
+
+			if (t < 0.25) {
+				double srt = sqrt(2*t);
+				for (int k = -3; k <= 3; ++k) {
+					double d = 2*k + 1 - x;
+					y += (d > 0 ? 1 : -1)*erfc(fabs(d)/srt);
+					p += d*exp(-d*d/(2*t));
+				}
+				*F = y;
+				*S = x - y;
+				*f = p/(sqrt(2*M_PI*t)*t);
+			}
+			else {
+				for (int m = 1; m <= 8; ++m) {
+					double e = (m&1 ? 1 : -1)*sin(m*M_PI*x)*exp(-m*m*M_PI*M_PI*t/2);
+					y += e/m;
+					p += e*m;
+				}
+				*S = 2*y/M_PI;
+				*F = x - *S;
+				*f = M_PI*p;
+			}
+		}
+		double side(bool hi) const
+		{
+			return hi ? x_ : 1 - x_;
+		}
+		// conditional on the side, unit interval
+		double solve(double u, bool hi, double t) const
+		{
+			ensure (0 < u && u < 1);
+
+			double x = side(hi);
+			double lo = t/2, up = 2*t, F, S, f;
+
+			for (unit(lo, x, &F, &S, &f); F > u*x; unit(lo, x, &F, &S, &f))
+				lo /= 2;
+			for (unit(up, x, &F, &S, &f); F < u*x; unit(up, x, &F, &S, &f))
+				up *= 2;
+
+			t = sqrt(lo*up);
+			for (int i = 0; i < 100; ++i) {
+				unit(t, x, &F, &S, &f);
+				// the smaller of F and S is accurate near the ends
+				double g = u < 0.5 ? F - u*x : (1 - u)*x - S;
+				if (g < 0)
+					lo = t;
+				else
+					up = t;
+
+				double t_ = t - g/f;
+				if (!(lo < t_ && t_ < up))
+					t_ = sqrt(lo*up);
+				if (fabs(t_ - t) <= 1e-14*t)
+					return t_;
+
+				t = t_;
+			}
+
+			return t;
+		}
+	public:
+		exit_time(double lo, double hi, std::size_t n = 4096)
+			: w_(hi - lo), x_(-lo/(hi - lo)), m_(1 + n/512)
+		{
+			ensure (lo < 0);
+			ensure (hi > 0);
+			ensure (n == 0 || n > 2*m_);
+
+			if (n == 0)
+				return;
+
+			for (int h = 0; h < 2; ++h) {
+				std::vector<double>& t_h = t_[h];
+				double t = 0.1;
+
+				t_h.resize(n + 1);
+				dt_[h].resize(n + 1);
+				for (std::size_t j = 1; j < n; ++j) {
+					double F, S, f;
+					t_h[j] = t = solve(static_cast<double>(j)/n, h == 1, t);
+					unit(t, side(h == 1), &F, &S, &f);
+					dt_[h][j] = side(h == 1)/(f*n);
+				}
+			}
+		}
+
+		// probability the high side is hit first
+		double probability(void) const
+		{
+			return x_;
+		}
+		// P(tau <= t, side)
+		double cdf(double t, bool hi) const
+		{
+			double F, S, f;
+
+			if (t <= 0)
+				return 0;
+
+			unit(t/(w_*w_), side(hi), &F, &S, &f);
+
+			return F;
+		}
+		// d/dt P(tau <= t, side)
+		double pdf(double t, bool hi) const
+		{
+			double F, S, f;
+
+			if (t <= 0)
+				return 0;
+
+			unit(t/(w_*w_), side(hi), &F, &S, &f);
+
+			return f/(w_*w_);
+		}
+		// t with P(tau <= t | side) = u
+		double inverse(double u, bool hi) const
+		{
+			const std::vector<double>& t_h = t_[hi];
+			std::size_t n = t_h.size() ? t_h.size() - 1 : 0;
+
+			if (n == 0)
+				return w_*w_*solve(u, hi, 0.1);
+
+			double t = u*n;
+			std::size_t j = static_cast<std::size_t>(t);
+
+			if (j < m_ || j >= n - m_)
+				return w_*w_*solve(u, hi, j < m_ ? t_h[m_] : t_h[n - m_]);
+
+			t -= j;
+
+			const std::vector<double>& d = dt_[hi];
+			double t0 = t_h[j], t1 = t_h[j + 1], d0 = d[j], d1 = d[j + 1];
+			double s = 1 - t;
+			return w_*w_*(s*s*((1 + 2*t)*t0 + t*d0) + t*t*((3 - 2*t)*t1 - s*d1));
+		}
+
+		// u picks the side and v the time
+		std::tuple<double,bool> operator()(double u, double v) const
+		{
+			bool hi = u < x_;
+
+			return std::make_tuple(inverse(v, hi), hi);
+		}
+		template<class RNG>
+		std::tuple<double,bool> operator()(RNG& rng) const
+		{
+			double u = rng.real();
 
-		ensure (lo < 0);
-		ensure (hi > 0);
+			return operator()(u, rng.real());
+		}
+		// t[i], hi[i] from u[i], v[i]. t may be the same array as u or v.
+		void operator()(std::size_t n, const double* u, const double* v, double* t, bool* hi) const
+		{
+			for (std::size_t i = 0; i < n; ++i) {
+				hi[i] = u[i] < x_;
+				t[i] = inverse(v[i], hi[i]);
+			}
+		}
 
-		double x;
+		// streaming statistics of n exits, high has mean P(hi)
+		struct result {
+			statistics::moments time, high;
+			statistics::digest quantile; // of time
+		};
+		// Block b of 4096 exits draws from rng::philox(seed, b) and blocks are merged in order.
+		result simulate(std::size_t n, parallel::pool& pool, std::uint64_t seed = 0) const
+		{
+			const std::size_t m = 4096;
+			std::size_t blocks = (n + m - 1)/m;
+			std::vector<result> r(blocks);
 
-		x = lo/normal_inv<ooura>((1 - rng.real())/2);
-		double Tlo = x*x;
+			pool.run(blocks, [&](std::size_t b) {
+				std::size_t p = std::min(m, n - b*m);
+				std::vector<double> u(2*p), t(p);
+				bool hi[m];
 
-		x = hi/normal_inv<ooura>((1 - rng.real())/2);
-		double Thi = x*x;
+				rng::philox(seed, b).real(2*p, &u[0]);
+				operator()(p, &u[0], &u[p], &t[0], hi);
+				for (std::size_t i = 0; i < p; ++i) {
+					r[b].time.add(t[i]);
+					r[b].high.add(hi[i]);
+					r[b].quantile.add(t[i]);
+				}
+				r[b].quantile.compress();
+			});
 
-		return std::make_tuple(min(Tlo, Thi), Thi < Tlo); // !!! not correct
+			result s;
+			for (std::size_t b = 0; b < blocks; ++b) {
+				s.time.merge(r[b].time);
+				s.high.merge(r[b].high);
+				s.quantile.merge(r[b].quantile);
+			}
+
+			return s;
+		}
+	};
+
+	// inf {t > 0 : min B_t > lo, max B_t < hi }, hi?
+	// Draws come from the caller's generator, e.g. rng::philox(seed, path), so paths are
+	// reproducible and independent of how they are split over threads.
+	// Use an exit_time table when sampling the same band repeatedly.
+	template<class RNG>
+	inline std::tuple<double,bool> hitting_time(double lo, double hi, RNG& rng)
+	{
+		return exit_time(lo, hi, 0)(rng);
 	}
 
 	// time limit order executes, hi?
-	inline std::tuple<double, bool> next_hit(double spot, double lo, double hi)
+	template<class RNG>
+	inline std::tuple<double, bool> next_hit(double spot, double lo, double hi, RNG& rng)
 	{
-		std::tuple<double,bool> db = hitting_time(0,0);
-		double d = std::get<0>(db);
-		bool b = std::get<1>(db);
-
-		return hitting_time(lo - spot, hi - spot);
+		return hitting_time(lo - spot, hi - spot, rng);
 	}
 
 	struct order {
@@ -42,12 +255,160 @@ namespace hedge {
 
 
 
-	// hedging standard Brownian motion
+	// Discrete delta hedging of a book of options on a lognormal forward.
+	// The book is bought at its Black value and hedged by selling Black delta futures.
+	// The forward is simulated on a grid of steps over [0, t] with volatility realized,
+	// the hedge is rebalanced every few steps and whenever the forward moves more than
+	// band (relative) from its level at the last rebalance, and each trade costs
+	// cost*|futures traded|*forward. P&L is book payoff - premium - futures gains - costs.
+	// Only streaming statistics are kept. Path i draws from rng::philox(seed, i) and blocks
+	// are merged in order, so the result does not depend on the number of threads.
 	class futures {
 	public:
-		// 
-		futures
-		{ }
+		// negative strike is a put
+		struct option {
+			double k, amount;
+		};
+		struct result {
+			statistics::moments pnl, cost, trades;
+			statistics::digest quantile; // of pnl
+		};
+	private:
+		double f_, sigma_, t_;
+		std::vector<option> book_;
+		double realized_, band_, cost_;
+		std::size_t steps_, every_, block_;
+
+		double value(double f, double tau, double* delta) const
+		{
+			double v = 0;
+
+			*delta = 0;
+			for (std::size_t j = 0; j < book_.size(); ++j) {
+				double d = 0;
+				v += book_[j].amount*black::black(f, sigma_, book_[j].k, tau, &d);
+				*delta += book_[j].amount*d;
+			}
+
+			return v;
+		}
+
+		// one path using u as scratch
+		void path(std::uint64_t seed, std::uint64_t i, double v0, double h0, std::vector<double>& u, result& r) const
+		{
+			rng::philox rng(seed, i);
+			rng.real(steps_, &u[0]);
+
+			double dt = t_/steps_;
+			double srdt = realized_*sqrt(dt);
+			double f = f_, fh = f_, h = h0;
+			double pnl = -v0, cost = cost_*fabs(h0)*f_;
+			std::size_t trades = 1;
+
+			for (std::size_t j = 0; j < steps_; ++j) {
+				double g = f*exp(-srdt*srdt/2 + srdt*normal_inv<ooura>(u[j]));
+				pnl -= h*(g - f);
+				f = g;
+
+				if (j + 1 == steps_)
+					break;
+
+				if ((every_ && (j + 1) % every_ == 0) || (band_ > 0 && fabs(f/fh - 1) > band_)) {
+					double h_;
+					value(f, t_ - (j + 1)*dt, &h_);
+					cost += cost_*fabs(h_ - h)*f;
+					h = h_;
+					fh = f;
+					++trades;
+				}
+			}
+
+			for (std::size_t j = 0; j < book_.size(); ++j)
+				pnl += book_[j].amount*black::black(f, 0, book_[j].k, 0);
+			pnl -= cost;
+
+			r.pnl.add(pnl);
+			r.quantile.add(pnl);
+			r.cost.add(cost);
+			r.trades.add(static_cast<double>(trades));
+		}
+	public:
+		futures(double f, double sigma, double t, const std::vector<option>& book)
+			: f_(f), sigma_(sigma), t_(t), book_(book),
+			  realized_(sigma), band_(0), cost_(0), steps_(250), every_(1), block_(1024)
+		{
+			ensure (f > 0);
+			ensure (sigma > 0);
+			ensure (t > 0);
+		}
+
+		// volatility of the simulated forward, defaults to the hedging volatility
+		futures& realized(double vol)
+		{
+			ensure (vol >= 0);
+			realized_ = vol;
+
+			return *this;
+		}
+		// simulation steps over [0, t]
+		futures& steps(std::size_t n)
+		{
+			ensure (n > 0);
+			steps_ = n;
+
+			return *this;
+		}
+		// rebalance every n steps, 0 for triggers only
+		futures& every(std::size_t n)
+		{
+			every_ = n;
+
+			return *this;
+		}
+		// also rebalance when |f/f_last - 1| > band, 0 for none
+		futures& band(double b)
+		{
+			ensure (b >= 0);
+			band_ = b;
+
+			return *this;
+		}
+		// proportional transaction cost
+		futures& cost(double c)
+		{
+			ensure (c >= 0);
+			cost_ = c;
+
+			return *this;
+		}
+
+		// statistics of n paths
+		result run(std::size_t n, parallel::pool& pool, std::uint64_t seed = 0) const
+		{
+			double h0;
+			double v0 = value(f_, t_, &h0);
+			std::size_t blocks = (n + block_ - 1)/block_;
+			std::vector<result> r(blocks);
+
+			pool.run(blocks, [&](std::size_t b) {
+				std::vector<double> u(steps_);
+				std::size_t end = std::min(n, (b + 1)*block_);
+
+				for (std::size_t i = b*block_; i < end; ++i)
+					path(seed, i, v0, h0, u, r[b]);
+				r[b].quantile.compress();
+			});
+
+			result s;
+			for (std::size_t b = 0; b < blocks; ++b) {
+				s.pnl.merge(r[b].pnl);
+				s.cost.merge(r[b].cost);
+				s.trades.merge(r[b].trades);
+				s.quantile.merge(r[b].quantile);
+			}
+
+			return s;
+		}
 	};
 
 } // namespace hedge
\ No newline at end of file
@@ -0,0 +1,271 @@
+// implied_telemetry.h - how black::implied_volatility found each root.
+// Included by black.h when BLACK_IMPLIED_TELEMETRY is defined. Each call records the bracket steps,
+// the path it finished on, the bisection or Newton iterations, the final residual and the time taken.
+// Records are kept per thread as the last call and added to a histogram over moneyness log(k/f)
+// and expiration, either directly or through a batch that is merged once at the end. As in stats.h
+// each thread adds to its own stripe, so threads only share a lock when there are more threads than
+// stripes, and readers merge the stripes.
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <mutex>
+
+namespace black {
+namespace telemetry {
+
+	// how a solve ended
+	enum path {
+		lucky = 0,     // the seed was within eps
+		bracketed = 1, // an end of the bracket was within eps
+		bisection = 2, // vega of the secant point below 1e-4
+		newton = 3,    // Newton-Raphson from the secant point
+		failed = 4,    // did not converge or ensure threw
+		bounds = 5,    // price outside the no arbitrage bounds
+		paths = 6
+	};
+
+	struct record {
+		double moneyness;   // log(k/f)
+		double expiration;
+		int bracket;        // steps expanding the bracket
+		int iterations;     // bisection or Newton steps
+		path end;
+		double residual;    // |black - p| at the root
+		double ns;
+	};
+
+	// bucket edges, cell (i, j) holds moneyness in [m[i-1], m[i]) and expiration in [t[j-1], t[j])
+	static const double moneyness_edge[] = {-.5, -.2, -.05, .05, .2, .5};
+	static const double expiration_edge[] = {1./12, .25, .5, 1, 2, 5};
+	enum {
+		moneyness_buckets = sizeof(moneyness_edge)/sizeof(*moneyness_edge) + 1,
+		expiration_buckets = sizeof(expiration_edge)/sizeof(*expiration_edge) + 1,
+		iteration_buckets = 16 // the last bucket counts 15 or more
+	};
+
+	inline int bucket(double x, const double* edge, int n)
+	{
+		int i = 0;
+
+		while (i < n - 1 && !(x < edge[i]))
+			++i;
+
+		return i;
+	}
+
+	struct cell {
+		std::size_t calls;
+		std::size_t end[paths];
+		std::size_t bracket, iterations; // sums
+		std::size_t histogram[iteration_buckets];
+		double residual; // largest
+		double ns;       // sum
+
+		void add(const record& r)
+		{
+			++calls;
+			++end[r.end];
+			bracket += r.bracket;
+			iterations += r.iterations;
+			++histogram[r.iterations < iteration_buckets ? r.iterations : iteration_buckets - 1];
+			if (r.end != failed && r.residual > residual)
+				residual = r.residual;
+			ns += r.ns;
+		}
+		void merge(const cell& c)
+		{
+			calls += c.calls;
+			for (int i = 0; i < paths; ++i)
+				end[i] += c.end[i];
+			bracket += c.bracket;
+			iterations += c.iterations;
+			for (int i = 0; i < iteration_buckets; ++i)
+				histogram[i] += c.histogram[i];
+			if (c.residual > residual)
+				residual = c.residual;
+			ns += c.ns;
+		}
+	};
+
+	struct histogram {
+		cell cells[moneyness_buckets][expiration_buckets];
+
+		histogram()
+		{
+			reset();
+		}
+		void reset(void)
+		{
+			cell zero = {0, {0}, 0, 0, {0}, 0, 0};
+
+			for (int i = 0; i < moneyness_buckets; ++i)
+				for (int j = 0; j < expiration_buckets; ++j)
+					cells[i][j] = zero;
+		}
+		void add(const record& r)
+		{
+			int i = bucket(r.moneyness, moneyness_edge, moneyness_buckets);
+			int j = bucket(r.expiration, expiration_edge, expiration_buckets);
+
+			cells[i][j].add(r);
+		}
+		void merge(const histogram& h)
+		{
+			for (int i = 0; i < moneyness_buckets; ++i)
+				for (int j = 0; j < expiration_buckets; ++j)
+					cells[i][j].merge(h.cells[i][j]);
+		}
+	};
+
+	// Every call in the process that was not part of a batch, and every batch when it ends,
+	// striped by thread.
+	enum { stripes = 16 };
+	struct alignas(64) stripe {
+		std::mutex m;
+		histogram h;
+	};
+	inline stripe* global_stripes(void)
+	{
+		static stripe s[stripes];
+
+		return s;
+	}
+	// stripe of this thread
+	inline stripe& local(void)
+	{
+		static std::atomic<std::size_t> n(0);
+		thread_local std::size_t i = n++;
+
+		return global_stripes()[i % stripes];
+	}
+	// Merge of the stripes, zeroed afterwards if reset. Every stripe is locked for the copy and
+	// the reset, so each record is either returned or kept.
+	inline histogram global(bool reset = false)
+	{
+		stripe* s = global_stripes();
+		histogram h;
+
+		for (int i = 0; i < stripes; ++i)
+			s[i].m.lock();
+		for (int i = 0; i < stripes; ++i) {
+			h.merge(s[i].h);
+			if (reset)
+				s[i].h.reset();
+		}
+		for (int i = stripes; i-- > 0; )
+			s[i].m.unlock();
+
+		return h;
+	}
+	inline void reset(void)
+	{
+		global(true);
+	}
+
+	// histogram of the batch running on this thread, if any
+	inline histogram*& current(void)
+	{
+		thread_local histogram* h = 0;
+
+		return h;
+	}
+	// most recent call on this thread
+	inline record& last(void)
+	{
+		thread_local record r = {0, 0, 0, 0, lucky, 0, 0};
+
+		return r;
+	}
+
+	inline void add(const record& r)
+	{
+		last() = r;
+
+		if (current()) {
+			current()->add(r);
+		}
+		else {
+			stripe& s = local();
+			std::lock_guard<std::mutex> lock(s.m);
+			s.h.add(r);
+		}
+	}
+
+	// Collect the calls on this thread while in scope and add them to the global histogram at the end.
+	class batch {
+		histogram h_;
+		histogram* prev_;
+	public:
+		batch()
+			: prev_(current())
+		{
+			current() = &h_;
+		}
+		batch(const batch&) = delete;
+		batch& operator=(const batch&) = delete;
+		~batch()
+		{
+			current() = prev_;
+			if (prev_) {
+				prev_->merge(h_);
+			}
+			else {
+				stripe& s = local();
+				std::lock_guard<std::mutex> lock(s.m);
+				s.h.merge(h_);
+			}
+		}
+		const histogram& get(void) const
+		{
+			return h_;
+		}
+	};
+
+	// One solve. The solver bumps the counters and calls done on each return,
+	// so a trace destroyed without done returned a failure or was unwound by an exception.
+	class trace {
+		record r_;
+		std::chrono::steady_clock::time_point t0_;
+		bool done_;
+	public:
+		trace(double f, double k, double t)
+			: t0_(std::chrono::steady_clock::now()), done_(false)
+		{
+			r_.moneyness = log(fabs(k)/f);
+			r_.expiration = t;
+			r_.bracket = 0;
+			r_.iterations = 0;
+			r_.end = failed;
+			r_.residual = 0;
+			r_.ns = 0;
+		}
+		trace(const trace&) = delete;
+		trace& operator=(const trace&) = delete;
+		~trace()
+		{
+			r_.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0_).count();
+			if (!done_)
+				r_.end = failed;
+			add(r_);
+		}
+
+		void bracket(void)
+		{
+			++r_.bracket;
+		}
+		void iteration(void)
+		{
+			++r_.iterations;
+		}
+		void done(path end, double residual)
+		{
+			r_.end = end;
+			r_.residual = fabs(residual);
+			done_ = true;
+		}
+	};
+
+} // namespace telemetry
+} // namespace black
@@ -1,7 +1,9 @@
 // jr.cpp - Jarrow Rudd option pricing.
 #include <cmath>
-#include "jr.h"
 #include "xll/xll.h"
+#include "jr.h"
+#include "memo.h"
+#include "stats.h"
 
 #define CATEGORY "CCM"
 
@@ -23,6 +25,7 @@ static AddIn xai_jr_a(
 xfp* WINAPI xll_jr_a(double s, double s0, double r, double t, double sigma)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("JR.A");
 	static xll::FP v(3,1);
 
 	dual::number<double,3> S(s, 1);
@@ -42,6 +45,9 @@ xfp* WINAPI xll_jr_a(double s, double s0, double r, double t, double sigma)
 
 #endif // _DEBUG
 
+// opt in with MEMO.ENABLE
+static memo::cache<double, memo::fixed<8> > jr_value_cache("JR.VALUE");
+
 static AddIn xai_jr_option(
 	Function(XLL_DOUBLE, "?xll_jr_value", "JR.VALUE")
 	.Arg(XLL_DOUBLE, "Spot", "is the spot price.", 100)
@@ -58,10 +64,15 @@ static AddIn xai_jr_option(
 double WINAPI xll_jr_value(double s, double r, double t, double sigma, double k, double dk2, double dk3, double dk4)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("JR.VALUE");
 	double v(std::numeric_limits<double>::quiet_NaN());
 
 	try {
-		v = jr::value(s, r, t, sigma, k, dk2, dk3, dk4);
+		double x[] = {s, r, t, sigma, k, dk2, dk3, dk4};
+
+		v = jr_value_cache(memo::make(x), [=]() {
+			return jr::value(s, r, t, sigma, k, dk2, dk3, dk4);
+		});
 	}
 	catch (const std::exception& ex) {
 		XLL_ERROR(ex.what());
@@ -3,7 +3,6 @@
 // Uncomment the following line to use features for Excel2007 and above.
 //#define EXCEL12
 #include <vector>
-#include "xll/utility/ensure.h"
 #include "black.h"
 #include "../fmsdual/dual.h"
 
@@ -36,6 +36,12 @@
 #define ensure(x) assert(x)
 #endif
 #include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "normal.h"
 
 
 namespace lkk {
@@ -50,44 +56,329 @@ namespace lkk {
 			   + (beta == 0 ? 0 : b/beta + b/beta*(1 - beta)*log(1 - beta));
 	}
 
+	// exp(x) for x <= 0 with no branches or library calls, so loops over it vectorize.
+	// x = k log(2) + r with |r| <= log(2)/2, exp(r) is its degree 12 Taylor polynomial and 2^k is added
+	// to the exponent bits. The relative error is below 1e-15 for -708 <= x <= 0 and callers clamp x.
+	inline double exp_nonpositive(double x)
+	{
+		const double round = 6755399441055744.; // 1.5 2^52, the sum has k in its low bits
+
+		double t = x*1.4426950408889634 + round;
+		double k = t - round;
+		double r = x - k*6.93147180369123816490e-01 - k*1.90821492927058770002e-10;
+		double p = 1/479001600.;
+		p = p*r + 1/39916800.;
+		p = p*r + 1/3628800.;
+		p = p*r + 1/362880.;
+		p = p*r + 1/40320.;
+		p = p*r + 1/5040.;
+		p = p*r + 1/720.;
+		p = p*r + 1/120.;
+		p = p*r + 1/24.;
+		p = p*r + 1/6.;
+		p = p*r + .5;
+		p = p*r + 1;
+		p = p*r + 1;
+
+		std::int64_t i, e;
+		std::memcpy(&i, &t, sizeof(i));
+		std::memcpy(&e, &p, sizeof(e));
+		e += i << 52;
+		std::memcpy(&p, &e, sizeof(p));
+
+		return p;
+	}
+
+	// Levy-Khintchine/Kolmogorov density with everything depending on (s, a, b) computed once.
+	// Each of the four exponentials in the density is a Gaussian in x with common variance
+	// v = s^2 - a - b + (2 - sqrt(2))(a^2 + b^2) and means (b - a) +- 2^(1/4)(b - a), (b - a) +- 2^(1/4)(a + b),
+	// so pdf(x) = c sum_i exp(-(x - m_i)^2/2v) where c = pi^(3/2)/(40 sqrt(2v)).
+	// The antiderivative of each term is a normal cdf so cdf and put have closed forms.
+	class distribution {
+		double v_;    // common variance
+		double sv_;   // sqrt(v)
+		double h_;    // 1/2v
+		double d_;    // 1416v, squared distances are clamped here so -h_ d >= -708
+		double c_;    // scale
+		double C_;    // c sqrt(2 pi v)
+		double m_[4]; // means
+	public:
+		distribution(double s, double a, double b)
+			: v_(s*s - a - b + (2 - M_SQRT2)*(a*a + b*b))
+		{
+			ensure (v_ > 0);
+
+			double q = pow(2., 0.25);
+
+			sv_ = sqrt(v_);
+			h_ = 1/(2*v_);
+			d_ = 1416*v_;
+			c_ = pow(M_PI, 1.5)/(40*sqrt(2*v_));
+			C_ = M_PI*M_PI/40;
+			m_[0] = (1 + q)*(b - a);
+			m_[1] = (b - a) - q*(a + b);
+			m_[2] = (b - a) + q*(a + b);
+			m_[3] = (1 - q)*(b - a);
+		}
+
+		double variance(void) const
+		{
+			return v_;
+		}
+		// cdf(infinity)
+		double mass(void) const
+		{
+			return 4*C_;
+		}
+		double mean(int i) const
+		{
+			return m_[i];
+		}
+
+		double pdf(double x) const
+		{
+			double x0 = x - m_[0], x1 = x - m_[1], x2 = x - m_[2], x3 = x - m_[3];
+
+			double d0 = x0*x0, d1 = x1*x1, d2 = x2*x2, d3 = x3*x3;
+
+			d0 = d0 > d_ ? d_ : d0;
+			d1 = d1 > d_ ? d_ : d1;
+			d2 = d2 > d_ ? d_ : d2;
+			d3 = d3 > d_ ? d_ : d3;
+
+			return c_*(exp_nonpositive(-h_*d0) + exp_nonpositive(-h_*d1) + exp_nonpositive(-h_*d2) + exp_nonpositive(-h_*d3));
+		}
+		// y[i] = pdf(x[i]), x and y may be the same array
+		// Points go through local blocks of 8 so the inner loop has a fixed trip count and no aliasing,
+		// which lets compilers vectorize it at their default optimization levels.
+		void pdf(std::size_t n, const double* x, double* y) const
+		{
+			double xb[8], yb[8];
+			std::size_t i = 0;
+
+			for (; i + 8 <= n; i += 8) {
+				for (int j = 0; j < 8; ++j)
+					xb[j] = x[i + j];
+				pdf8(xb, yb);
+				for (int j = 0; j < 8; ++j)
+					y[i + j] = yb[j];
+			}
+			if (i < n) {
+				for (std::size_t j = 0; j < 8; ++j)
+					xb[j] = i + j < n ? x[i + j] : 0;
+				pdf8(xb, yb);
+				for (std::size_t j = 0; i + j < n; ++j)
+					y[i + j] = yb[j];
+			}
+		}
+	private:
+		void pdf8(const double (&x)[8], double (&y)[8]) const
+		{
+			const double m0 = m_[0], m1 = m_[1], m2 = m_[2], m3 = m_[3];
+			const double h = h_, c = c_, d = d_;
+
+			for (int j = 0; j < 8; ++j) {
+				double x0 = x[j] - m0, x1 = x[j] - m1, x2 = x[j] - m2, x3 = x[j] - m3;
+				double d0 = x0*x0, d1 = x1*x1, d2 = x2*x2, d3 = x3*x3;
+
+				d0 = d0 > d ? d : d0;
+				d1 = d1 > d ? d : d1;
+				d2 = d2 > d ? d : d2;
+				d3 = d3 > d ? d : d3;
+				y[j] = c*(exp_nonpositive(-h*d0) + exp_nonpositive(-h*d1) + exp_nonpositive(-h*d2) + exp_nonpositive(-h*d3));
+			}
+		}
+	public:
+
+		// int_-infty^x pdf(y) dy = c sqrt(2 pi v) sum_i N((x - m_i)/sqrt(v))
+		double cdf(double x) const
+		{
+			return C_*(normal_cdf<ooura>((x - m_[0])/sv_) + normal_cdf<ooura>((x - m_[1])/sv_)
+			         + normal_cdf<ooura>((x - m_[2])/sv_) + normal_cdf<ooura>((x - m_[3])/sv_));
+		}
+
+		// int_-infty^x exp(y) pdf(y) dy = c sqrt(2 pi v) sum_i exp(m_i + v/2) N((x - m_i - v)/sqrt(v))
+		double cdf_exp(double x) const
+		{
+			double y(0);
+
+			for (int i = 0; i < 4; ++i)
+				y += exp(m_[i] + v_/2)*normal_cdf<ooura>((x - m_[i] - v_)/sv_);
+
+			return C_*y;
+		}
+
+		// int (k - f exp(-kap + x))^+ pdf(x) dx
+		double put(double f, double k, double kap) const
+		{
+			double x = log(k/f) + kap;
+
+			return k*cdf(x) - f*exp(-kap)*cdf_exp(x);
+		}
+
+		// int_R exp(iux) pdf(x) dx = c sqrt(2 pi v) sum_i exp(i u m_i - v u^2/2) for complex u
+		std::complex<double> characteristic(const std::complex<double>& u) const
+		{
+			const std::complex<double> I(0, 1);
+			std::complex<double> y(0);
+
+			for (int i = 0; i < 4; ++i)
+				y += exp(I*u*m_[i] - v_*u*u/2.);
+
+			return C_*y;
+		}
+
+		// y[i] = cdf(x[i]), x and y may be the same array
+		void cdf(std::size_t n, const double* x, double* y) const
+		{
+			const double m0 = m_[0], m1 = m_[1], m2 = m_[2], m3 = m_[3];
+			const double r = 1/sv_, C = C_;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				double xi = x[i];
+
+				y[i] = C*(normal_cdf<ooura>((xi - m0)*r) + normal_cdf<ooura>((xi - m1)*r)
+				        + normal_cdf<ooura>((xi - m2)*r) + normal_cdf<ooura>((xi - m3)*r));
+			}
+		}
+
+		// p[i] = put(f, k[i], kap), k and p may be the same array
+		// The coefficients f exp(-kap) c sqrt(2 pi v) exp(m_i + v/2) are shared by all strikes.
+		void put(double f, std::size_t n, const double* k, double* p, double kap) const
+		{
+			double e[4], mv[4];
+			for (int j = 0; j < 4; ++j) {
+				e[j] = f*exp(-kap + m_[j] + v_/2)*C_;
+				mv[j] = m_[j] + v_;
+			}
+			const double x0 = kap - log(f), r = 1/sv_, C = C_;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				double ki = k[i];
+				double x = log(ki) + x0;
+
+				p[i] = ki*C*(normal_cdf<ooura>((x - m_[0])*r) + normal_cdf<ooura>((x - m_[1])*r)
+				           + normal_cdf<ooura>((x - m_[2])*r) + normal_cdf<ooura>((x - m_[3])*r))
+					 - (e[0]*normal_cdf<ooura>((x - mv[0])*r) + e[1]*normal_cdf<ooura>((x - mv[1])*r)
+					  + e[2]*normal_cdf<ooura>((x - mv[2])*r) + e[3]*normal_cdf<ooura>((x - mv[3])*r));
+			}
+		}
+	};
+
+	// Sampler for the LKK distribution normalized to have mass 1.
+	// The quantile function is tabulated at u = j/n and linearly interpolated, which keeps it monotone.
+	// The first and last n/512 cells, where the quantile has large curvature, are inverted exactly.
+	class quantile {
+		distribution d_;
+		std::vector<double> x_; // x_[j] = inverse(j/n), 0 < j < n
+		std::size_t m_;         // number of exact cells at each end
+	public:
+		quantile(double s, double a, double b, std::size_t n = 8192)
+			: d_(s, a, b), x_(n + 1), m_(1 + n/512)
+		{
+			ensure (n > 2*m_);
+
+			double x = d_.mean(0);
+			for (std::size_t j = 1; j < n; ++j)
+				x_[j] = x = inverse(static_cast<double>(j)/n, x);
+		}
+
+		const distribution& density(void) const
+		{
+			return d_;
+		}
+
+		// solve cdf(x) = u*mass using Newton steps safeguarded by bisection
+		double inverse(double u, double x) const
+		{
+			ensure (0 < u && u < 1);
+
+			double y = u*d_.mass(), sv = sqrt(d_.variance());
+			double lo = x - sv, hi = x + sv;
+
+			while (d_.cdf(lo) > y)
+				lo -= 4*sv;
+			while (d_.cdf(hi) < y)
+				hi += 4*sv;
+
+			x = (lo + hi)/2;
+			for (int i = 0; i < 100; ++i) {
+				double fx = d_.cdf(x) - y;
+				if (fx < 0)
+					lo = x;
+				else
+					hi = x;
+
+				double x_ = x - fx/d_.pdf(x);
+				if (!(lo < x_ && x_ < hi))
+					x_ = (lo + hi)/2;
+				if (fabs(x_ - x) <= 1e-14*(1 + fabs(x)))
+					return x_;
+
+				x = x_;
+			}
+
+			return x;
+		}
+
+		double operator()(double u) const
+		{
+			ensure (0 < u && u < 1);
+
+			std::size_t n = x_.size() - 1;
+			double t = u*n;
+			std::size_t j = static_cast<std::size_t>(t);
+
+			if (j < m_ || j >= n - m_)
+				return inverse(u, j < m_ ? x_[m_] : x_[n - m_]);
+
+			t -= j;
+
+			return x_[j] + t*(x_[j + 1] - x_[j]);
+		}
+		// x[i] = quantile(u[i]), u and x may be the same array
+		void operator()(std::size_t n, const double* u, double* x) const
+		{
+			for (std::size_t i = 0; i < n; ++i)
+				x[i] = operator()(u[i]);
+		}
+	};
+
 	// always assume s = 1 so this acts more like a standard normal???
 	template<class Ty, class Tx, class Ts, class Ta, class Tb>
 	inline Ty pdf(Tx x, Ts s, Ta a, Tb b)
 	{
-		return
-0.1*(exp((2*((1 + M_SQRT2)*a*a + (1 + M_SQRT2)*b*b - 2*a*(b - x) - 
-           2*b*x + x*x))/
-       (a + (-2 + M_SQRT2)*a*a + b + (-2 + M_SQRT2)*b*b - s*s))*
-     (exp(((-3 + 2*pow(2,0.25) - 3*M_SQRT2)*a*a + 
-           (-3 + 2*pow(2,0.25) - 3*M_SQRT2)*b*b - 
-           2*(-3 + pow(2,0.25))*b*x - 3*x*x - 
-           2*a*((-3 + 2*pow(2,0.25) + M_SQRT2)*b - (-3 + pow(2,0.25))*x))/
-         (2.*(a + (-2 + M_SQRT2)*a*a + b + (-2 + M_SQRT2)*b*b - 
-             s*s))) + exp(
-        ((-3 + 2*pow(2,0.25) - 3*M_SQRT2)*a*a - 
-           (3 + 2*pow(2,0.25) + 3*M_SQRT2)*b*b + 
-           2*(3 + pow(2,0.25))*b*x - 3*x*x + 
-           2*a*((3 + M_SQRT2)*b + (-3 + pow(2,0.25))*x))/
-         (2.*(a + (-2 + M_SQRT2)*a*a + b + (-2 + M_SQRT2)*b*b - 
-             s*s))) + exp(
-        ((-3 - 2*pow(2,0.25) - 3*M_SQRT2)*a*a + 
-           (-3 + 2*pow(2,0.25) - 3*M_SQRT2)*b*b - 
-           2*(-3 + pow(2,0.25))*b*x - 3*x*x + 
-           2*a*((3 + M_SQRT2)*b - (3 + pow(2,0.25))*x))/
-         (2.*(a + (-2 + M_SQRT2)*a*a + b + (-2 + M_SQRT2)*b*b - 
-             s*s))) + exp(
-        -((3 + 2*pow(2,0.25) + 3*M_SQRT2)*a*a + 
-            (3 + 2*pow(2,0.25) + 3*M_SQRT2)*b*b - 
-            2*(3 + pow(2,0.25))*b*x + 3*x*x + 
-            2*a*((-3 - 2*pow(2,0.25) + M_SQRT2)*b + (3 + pow(2,0.25))*x))/
-         (2.*(a + (-2 + M_SQRT2)*a*a + b + (-2 + M_SQRT2)*b*b - 
-             s*s))))*pow(M_PI,1.5))/
-   (4.*M_SQRT2*sqrt(-a - (-2 + M_SQRT2)*a*a - b - (-2 + M_SQRT2)*b*b + 
-       s*s))		;
+		return distribution(s, a, b).pdf(x);
 	}
 
 	template<class Ty, class Tx, class Ts, class Ta, class Tb>
 	inline Ty cdf(Tx x, Ts s, Ta a, Tb b)
+	{
+		return distribution(s, a, b).cdf(x);
+	}
+
+	template<class Ty, class Tf, class Ts, class Tk, class Tt>
+	inline Ty put(Tf f, Ts s, double a, double b, Tk k, Tt t)
+	{
+		return distribution(s, a, b).put(f, k, kappa(s, a, a, b, b));
+	}
+
+	// Array versions. Each value is a closed form so the input need not be sorted.
+	// y[i] = cdf(x[i], s, a, b)
+	inline void cdf(std::size_t n, const double* x, double* y, double s, double a, double b)
+	{
+		distribution(s, a, b).cdf(n, x, y);
+	}
+	// p[i] = put(f, s, a, b, k[i], t)
+	inline void put(double f, double s, double a, double b, std::size_t n, const double* k, double* p, double t)
+	{
+		distribution(s, a, b).put(f, n, k, p, kappa(s, a, a, b, b));
+	}
+
+	// Trapezoid walks left from x until the density is negligible.
+	// The number of pdf calls depends on the parameters. Kept as a reference for the closed forms.
+	template<class Ty, class Tx, class Ts, class Ta, class Tb>
+	inline Ty cdf_trapezoid(Tx x, Ts s, Ta a, Tb b)
 	{
 		Ty x_(x), y(0);
 		Ty fx = pdf<double,double,double,double,double>(x_, s, a, b);
@@ -104,7 +395,7 @@ namespace lkk {
 		return y;
 	}
 	template<class Ty, class Tf, class Ts, class Tk, class Tt>
-	inline Ty put(Tf f, Ts s, double a, double b, Tk k, Tt t)
+	inline Ty put_trapezoid(Tf f, Ts s, double a, double b, Tk k, Tt t)
 	{
 		double kap = kappa(s, a, a, b, b);
 
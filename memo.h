@@ -0,0 +1,290 @@
+// memo.h - bounded concurrent caches of function results keyed on the exact bits of the arguments.
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef ensure
+#include <cassert>
+#define ensure(x) assert(x)
+#endif
+
+namespace memo {
+
+	// argument bits, so 0.0 and -0.0 differ and a NaN argument only matches the same NaN
+	typedef std::vector<std::uint64_t> key;
+	// key of a function with N scalar arguments, built without allocating
+	template<std::size_t N>
+	using fixed = std::array<std::uint64_t, N>;
+
+	inline std::uint64_t bits(double x)
+	{
+		std::uint64_t u;
+		std::memcpy(&u, &x, sizeof(u));
+
+		return u;
+	}
+	// append the bits of n doubles
+	inline key& append(key& k, std::size_t n, const double* x)
+	{
+		for (std::size_t i = 0; i < n; ++i)
+			k.push_back(bits(x[i]));
+
+		return k;
+	}
+	// bits of the N arguments x
+	template<std::size_t N>
+	inline fixed<N> make(const double (&x)[N])
+	{
+		fixed<N> k;
+
+		for (std::size_t i = 0; i < N; ++i)
+			k[i] = bits(x[i]);
+
+		return k;
+	}
+
+	// key or fixed
+	struct hash {
+		template<class K>
+		std::size_t operator()(const K& k) const
+		{
+			std::uint64_t h = 0x9E3779B97F4A7C15ull ^ k.size();
+
+			for (std::size_t i = 0; i < k.size(); ++i) {
+				h ^= k[i] + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+				h *= 0xBF58476D1CE4E5B9ull;
+			}
+
+			return static_cast<std::size_t>(h ^ (h >> 31));
+		}
+	};
+
+	// What every cache reports, so callers can list and control caches by name.
+	class base {
+		std::string name_;
+		std::atomic<bool> enabled_;
+	protected:
+		std::atomic<std::uint64_t> hits_, misses_, evictions_;
+
+		explicit base(const std::string& name)
+			: name_(name), enabled_(false), hits_(0), misses_(0), evictions_(0)
+		{
+			std::lock_guard<std::mutex> lock(registry_mutex());
+			registry().push_back(this);
+		}
+	public:
+		base(const base&) = delete;
+		base& operator=(const base&) = delete;
+		virtual ~base()
+		{
+			std::lock_guard<std::mutex> lock(registry_mutex());
+			std::vector<base*>& r = registry();
+			for (std::size_t i = 0; i < r.size(); ++i)
+				if (r[i] == this) {
+					r.erase(r.begin() + i);
+					break;
+				}
+		}
+
+		// every cache in the process, in order of construction
+		static std::vector<base*>& registry(void)
+		{
+			static std::vector<base*> r;
+
+			return r;
+		}
+		static std::mutex& registry_mutex(void)
+		{
+			static std::mutex m;
+
+			return m;
+		}
+		// cache with name, or 0
+		static base* find(const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(registry_mutex());
+			const std::vector<base*>& r = registry();
+			for (std::size_t i = 0; i < r.size(); ++i)
+				if (r[i]->name() == name)
+					return r[i];
+
+			return 0;
+		}
+
+		const std::string& name(void) const
+		{
+			return name_;
+		}
+		// caches start disabled and callers opt in
+		bool enabled(void) const
+		{
+			return enabled_.load(std::memory_order_relaxed);
+		}
+		void enable(bool b = true)
+		{
+			enabled_ = b;
+			if (!b)
+				clear();
+		}
+		std::uint64_t hits(void) const
+		{
+			return hits_;
+		}
+		std::uint64_t misses(void) const
+		{
+			return misses_;
+		}
+		std::uint64_t evictions(void) const
+		{
+			return evictions_;
+		}
+		void reset(void)
+		{
+			hits_ = misses_ = evictions_ = 0;
+		}
+		virtual std::size_t size(void) const = 0;
+		virtual std::size_t capacity(void) const = 0;
+		virtual void clear(void) = 0;
+	};
+
+	// At most capacity values of type V with CLOCK eviction. Keys are split over shards, each with a
+	// reader-writer lock, so lookups of different keys and repeated lookups of the same key proceed
+	// together. A lookup only sets the reference bit of its slot, which is atomic. On a miss the value
+	// is computed without holding a lock, so two threads may compute the same value and one is kept.
+	// K is key for variable length arguments or fixed<N> for scalar functions.
+	template<class V = double, class K = key>
+	class cache : public base {
+		struct slot {
+			K k;
+			V v;
+			std::atomic<bool> ref;
+			slot() : ref(false) { }
+		};
+		struct shard {
+			mutable std::shared_timed_mutex m;
+			std::unordered_map<K, std::size_t, hash> index;
+			std::vector<slot> s;
+			std::size_t used, hand;
+
+			explicit shard(std::size_t n)
+				: s(n), used(0), hand(0)
+			{ }
+		};
+		std::size_t capacity_;
+		std::vector<std::unique_ptr<shard> > shard_;
+
+		shard& get(const K& k) const
+		{
+			return *shard_[hash()(k) % shard_.size()];
+		}
+	public:
+		cache(const std::string& name, std::size_t capacity = 1 << 14, std::size_t shards = 16)
+			: base(name), capacity_(capacity)
+		{
+			ensure (shards > 0);
+			ensure (capacity >= shards);
+
+			for (std::size_t i = 0; i < shards; ++i)
+				shard_.emplace_back(new shard((capacity + i)/shards));
+		}
+
+		bool find(const K& k, V& v) const
+		{
+			shard& s = get(k);
+			std::shared_lock<std::shared_timed_mutex> lock(s.m);
+
+			typename std::unordered_map<K, std::size_t, hash>::const_iterator i = s.index.find(k);
+			if (i == s.index.end())
+				return false;
+
+			slot& e = s.s[i->second];
+			e.ref.store(true, std::memory_order_relaxed);
+			v = e.v;
+
+			return true;
+		}
+		void insert(const K& k, const V& v)
+		{
+			shard& s = get(k);
+			std::unique_lock<std::shared_timed_mutex> lock(s.m);
+
+			if (s.index.count(k))
+				return;
+
+			std::size_t j;
+			if (s.used < s.s.size()) {
+				j = s.used++;
+			}
+			else {
+				// second chance: clear reference bits until an unreferenced slot comes up
+				while (s.s[s.hand].ref.exchange(false, std::memory_order_relaxed))
+					s.hand = (s.hand + 1) % s.s.size();
+				j = s.hand;
+				s.hand = (s.hand + 1) % s.s.size();
+				s.index.erase(s.s[j].k);
+				++evictions_;
+			}
+
+			s.s[j].k = k;
+			s.s[j].v = v;
+			s.s[j].ref.store(false, std::memory_order_relaxed);
+			s.index[k] = j;
+		}
+
+		// f() if disabled, else the cached value for k, calling f() on a miss
+		template<class F>
+		V operator()(const K& k, F f)
+		{
+			if (!enabled())
+				return f();
+
+			V v;
+			if (find(k, v)) {
+				++hits_;
+
+				return v;
+			}
+
+			++misses_;
+			v = f();
+			insert(k, v);
+
+			return v;
+		}
+
+		std::size_t size(void) const
+		{
+			std::size_t n = 0;
+
+			for (std::size_t i = 0; i < shard_.size(); ++i) {
+				std::shared_lock<std::shared_timed_mutex> lock(shard_[i]->m);
+				n += shard_[i]->index.size();
+			}
+
+			return n;
+		}
+		std::size_t capacity(void) const
+		{
+			return capacity_;
+		}
+		void clear(void)
+		{
+			for (std::size_t i = 0; i < shard_.size(); ++i) {
+				shard& s = *shard_[i];
+				std::unique_lock<std::shared_timed_mutex> lock(s.m);
+				s.index.clear();
+				s.used = s.hand = 0;
+			}
+		}
+	};
+
+} // namespace memo
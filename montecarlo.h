@@ -0,0 +1,197 @@
+// montecarlo.h - Monte Carlo values of European options with Black control variates.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "black.h"
+#include "normal.h"
+#include "parallel.h"
+#include "philox.h"
+
+namespace montecarlo {
+
+	// value and its standard error
+	struct estimate {
+		double value, error;
+	};
+
+	// count, means and centered co-moments of (x, y) that can be merged
+	struct moments {
+		double n, x, y, xx, yy, xy;
+
+		moments()
+			: n(0), x(0), y(0), xx(0), yy(0), xy(0)
+		{ }
+		// two pass over one batch
+		moments(std::size_t m, const double* x_, const double* y_)
+			: n(static_cast<double>(m)), x(0), y(0), xx(0), yy(0), xy(0)
+		{
+			for (std::size_t i = 0; i < m; ++i) {
+				x += x_[i];
+				y += y_[i];
+			}
+			x /= n;
+			y /= n;
+			for (std::size_t i = 0; i < m; ++i) {
+				double dx = x_[i] - x, dy = y_[i] - y;
+				xx += dx*dx;
+				yy += dy*dy;
+				xy += dx*dy;
+			}
+		}
+		// Chan, Golub and LeVeque pairwise update
+		void merge(const moments& m)
+		{
+			if (m.n == 0)
+				return;
+
+			double n_ = n + m.n, w = n*m.n/n_;
+			double dx = m.x - x, dy = m.y - y;
+
+			xx += m.xx + dx*dx*w;
+			yy += m.yy + dy*dy*w;
+			xy += m.xy + dx*dy*w;
+			x += dx*m.n/n_;
+			y += dy*m.n/n_;
+			n = n_;
+		}
+	};
+
+	// E[payoff(F)] for F = f exp(X - kap) at strikes k, negative strikes are puts as in black::black.
+	// The sampler maps uniforms to X in batches, sampler(n, u, x), like lkk::quantile.
+	// The control variate is the Black payoff of f exp(s Z - s^2/2), s = vol sqrt(t), with Z = normal_inv(u)
+	// from the same uniform, so it is comonotone with X. Its value is black::black(f, vol, k, t) and
+	// the coefficient beta = cov(x, y)/var(y) is estimated from the same samples.
+	// Samples come in chunks, chunk c uses rng::philox(seed, c) and chunks are merged in order,
+	// so estimates do not depend on the number of threads. Each run adds to the estimates.
+	// The sampler is copied so a temporary can be passed to the constructor.
+	template<class Sampler>
+	class european {
+		Sampler X_;
+		double f_, kap_, vol_, t_;
+		std::vector<double> k_, y_; // strikes and control variate values
+		bool antithetic_;
+		std::size_t chunk_;
+		std::uint64_t seed_, next_; // next chunk
+		std::vector<moments> m_;    // per strike
+
+		// moments of one chunk for every strike using 5 chunk_ doubles of scratch
+		void sample(std::uint64_t c, std::vector<moments>& m, double* scratch) const
+		{
+			std::size_t n = chunk_, h = antithetic_ ? n/2 : n;
+			double* u = scratch, * x = u + n, * z = x + n, * px = z + n, * py = px + n;
+
+			rng::philox(seed_, c).real(h, u);
+			for (std::size_t i = h; i < n; ++i)
+				u[i] = 1 - u[i - h];
+
+			X_(n, u, x);
+			normal_inv<ooura>(n, u, z);
+
+			double s = vol_*sqrt(t_), e = f_*exp(-kap_), eb = f_*exp(-s*s/2);
+			for (std::size_t i = 0; i < n; ++i) {
+				x[i] = e*exp(x[i]);
+				z[i] = eb*exp(s*z[i]);
+			}
+
+			for (std::size_t j = 0; j < k_.size(); ++j) {
+				double c = k_[j] < 0 ? -1 : 1, k = fabs(k_[j]);
+
+				for (std::size_t i = 0; i < n; ++i) {
+					px[i] = std::max(c*(x[i] - k), 0.);
+					py[i] = std::max(c*(z[i] - k), 0.);
+				}
+				// pair averages are the independent samples
+				if (antithetic_)
+					for (std::size_t i = 0; i < h; ++i) {
+						px[i] = (px[i] + px[i + h])/2;
+						py[i] = (py[i] + py[i + h])/2;
+					}
+
+				m[j] = moments(h, px, py);
+			}
+		}
+	public:
+		european(const Sampler& X, double f, double kap, double t, const std::vector<double>& k, double vol)
+			: X_(X), f_(f), kap_(kap), vol_(vol), t_(t), k_(k), y_(k.size()),
+			  antithetic_(false), chunk_(4096), seed_(0), next_(0), m_(k.size())
+		{
+			ensure (f > 0);
+			ensure (t > 0);
+			ensure (vol > 0);
+
+			for (std::size_t j = 0; j < k.size(); ++j)
+				y_[j] = black::black(f, vol, k[j], t);
+		}
+
+		// pair each uniform u with 1 - u, must be set before the first run
+		european& antithetic(bool b = true)
+		{
+			ensure (next_ == 0);
+			antithetic_ = b;
+
+			return *this;
+		}
+		european& seed(std::uint64_t s)
+		{
+			ensure (next_ == 0);
+			seed_ = s;
+
+			return *this;
+		}
+
+		// add at least n samples using the pool
+		// Each job takes a contiguous run of chunks and allocates its scratch once.
+		void run(std::size_t n, parallel::pool& pool)
+		{
+			std::size_t c = (n + chunk_ - 1)/chunk_;
+			std::size_t g = std::min(c, 4*pool.size());
+			std::vector<std::vector<moments> > m(c, std::vector<moments>(k_.size()));
+
+			pool.run(g, [&](std::size_t i) {
+				std::vector<double> scratch(5*chunk_);
+
+				for (std::size_t j = i*c/g; j < (i + 1)*c/g; ++j)
+					sample(next_ + j, m[j], &scratch[0]);
+			});
+
+			for (std::size_t i = 0; i < c; ++i)
+				for (std::size_t j = 0; j < k_.size(); ++j)
+					m_[j].merge(m[i][j]);
+			next_ += c;
+		}
+
+		// variates drawn so far, antithetic pairs count twice
+		std::size_t samples(void) const
+		{
+			return static_cast<std::size_t>(next_*chunk_);
+		}
+		double beta(std::size_t j) const
+		{
+			const moments& m = m_[j];
+
+			return m.yy > 0 ? m.xy/m.yy : 0;
+		}
+		// sample mean
+		estimate plain(std::size_t j) const
+		{
+			const moments& m = m_[j];
+			estimate e = {m.x, m.n > 1 ? sqrt(m.xx/(m.n - 1)/m.n) : 0};
+
+			return e;
+		}
+		// x - beta (y - E[y])
+		estimate control(std::size_t j) const
+		{
+			const moments& m = m_[j];
+			double b = beta(j);
+			double r = m.xx - b*m.xy; // residual sum of squares
+			estimate e = {m.x - b*(m.y - y_[j]), m.n > 2 ? sqrt(std::max(r, 0.)/(m.n - 2)/m.n) : 0};
+
+			return e;
+		}
+	};
+
+} // namespace montecarlo
@@ -1,6 +1,7 @@
 // normal.h - Normally distributed random variables.
 #pragma once
 #include <cmath>
+#include <cstddef>
 #include <limits>
 #include "ooura.h"
 
@@ -60,6 +61,15 @@ normal_inv<ooura>(double p)
 	return M_SQRT2*dierfc<ooura>(2*(1 - p));
 }
 
+// x[i] = normal_inv<T>(p[i]), p and x may be the same array.
+// dierfc<ooura> has no branches so this loop vectorizes with fast floating point (/fp:fast, -ffast-math).
+template<class T>
+inline void normal_inv(std::size_t n, const double* p, double* x)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		x[i] = normal_inv<T>(p[i]);
+}
+
 // Abramowitz and Stegun. Handbook of Mathematical functions 26.24
 class AS_P1 {};
 template<> inline double
@@ -0,0 +1,117 @@
+// parallel.h - fixed size thread pool for running independent jobs.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+	// Workers are started once and reused by every call to run.
+	// run(n, f) calls f(i) for i = 0,...,n - 1 and returns when all calls are done.
+	// The calling thread also works, so a pool of size 1 starts no threads.
+	class pool {
+		std::vector<std::thread> worker_;
+		std::mutex mutex_;
+		std::condition_variable start_, done_;
+		const std::function<void(std::size_t)>* job_;
+		std::size_t n_;
+		std::atomic<std::size_t> next_;
+		std::size_t busy_;       // workers still in the current job
+		unsigned long long gen_; // incremented for each job
+		bool stop_;
+		std::exception_ptr error_;
+
+		void work(void)
+		{
+			for (std::size_t i; (i = next_++) < n_; ) {
+				try {
+					(*job_)(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (!error_)
+						error_ = std::current_exception();
+				}
+			}
+		}
+		void loop(void)
+		{
+			unsigned long long gen = 0;
+
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					start_.wait(lock, [&] { return stop_ || gen_ != gen; });
+					if (stop_)
+						return;
+					gen = gen_;
+				}
+
+				work();
+
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (--busy_ == 0)
+					done_.notify_one();
+			}
+		}
+	public:
+		// threads = 0 uses the hardware concurrency
+		explicit pool(std::size_t threads = 0)
+			: job_(0), n_(0), next_(0), busy_(0), gen_(0), stop_(false)
+		{
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+
+			for (std::size_t i = 1; i < threads; ++i)
+				worker_.push_back(std::thread(&pool::loop, this));
+		}
+		pool(const pool&) = delete;
+		pool& operator=(const pool&) = delete;
+		~pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			start_.notify_all();
+			for (auto& w : worker_)
+				w.join();
+		}
+
+		std::size_t size(void) const
+		{
+			return worker_.size() + 1;
+		}
+
+		// not reentrant: f must not call run on the same pool
+		void run(std::size_t n, const std::function<void(std::size_t)>& f)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				job_ = &f;
+				n_ = n;
+				next_ = 0;
+				busy_ = worker_.size();
+				error_ = nullptr;
+				++gen_;
+			}
+			start_.notify_all();
+
+			work();
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			done_.wait(lock, [&] { return busy_ == 0; });
+			job_ = 0;
+
+			if (error_)
+				std::rethrow_exception(error_);
+		}
+	};
+
+} // namespace parallel
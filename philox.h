@@ -0,0 +1,123 @@
+// philox.h - counter based random number generator with independent streams.
+// Salmon, Moraes, Dror and Shaw 2011, "Parallel random numbers: as easy as 1, 2, 3", SC11.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace rng {
+
+	// Philox4x32-10. The output is a pure function of (stream, substream, position), so
+	// a worker thread or block of paths that owns a (stream, substream) pair draws the same
+	// numbers no matter how many threads run or in what order.
+	// The key is the 64-bit stream, the counter holds the 64-bit substream and the 64-bit block index.
+	class philox {
+		std::uint32_t key_[2];
+		std::uint32_t ctr_[4]; // block index low, high, substream low, high
+		std::uint32_t buf_[4];
+		int i_;                // next unused word of buf_
+
+		static std::uint32_t mulhilo(std::uint32_t a, std::uint32_t b, std::uint32_t* hi)
+		{
+			std::uint64_t p = static_cast<std::uint64_t>(a)*b;
+			*hi = static_cast<std::uint32_t>(p >> 32);
+
+			return static_cast<std::uint32_t>(p);
+		}
+		void next(void)
+		{
+			block(ctr_, key_, buf_);
+			if (++ctr_[0] == 0)
+				++ctr_[1];
+			i_ = 0;
+		}
+	public:
+		philox(std::uint64_t stream, std::uint64_t substream = 0)
+			: i_(4)
+		{
+			key_[0] = static_cast<std::uint32_t>(stream);
+			key_[1] = static_cast<std::uint32_t>(stream >> 32);
+			ctr_[2] = static_cast<std::uint32_t>(substream);
+			ctr_[3] = static_cast<std::uint32_t>(substream >> 32);
+			seek(0);
+		}
+
+		// the 4 words of block ctr for key
+		static void block(const std::uint32_t ctr[4], const std::uint32_t key[2], std::uint32_t out[4])
+		{
+			std::uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+			std::uint32_t k0 = key[0], k1 = key[1];
+
+			for (int r = 0; r < 10; ++r) {
+				std::uint32_t hi0, hi1;
+				std::uint32_t lo0 = mulhilo(0xD2511F53, c0, &hi0);
+				std::uint32_t lo1 = mulhilo(0xCD9E8D57, c2, &hi1);
+
+				c0 = hi1 ^ c1 ^ k0;
+				c1 = lo1;
+				c2 = hi0 ^ c3 ^ k1;
+				c3 = lo0;
+
+				k0 += 0x9E3779B9;
+				k1 += 0xBB67AE85;
+			}
+
+			out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+		}
+
+		// start at block i of the substream
+		void seek(std::uint64_t i)
+		{
+			ctr_[0] = static_cast<std::uint32_t>(i);
+			ctr_[1] = static_cast<std::uint32_t>(i >> 32);
+			i_ = 4;
+		}
+
+		// uniform 32-bit integer
+		std::uint32_t operator()(void)
+		{
+			if (i_ == 4)
+				next();
+
+			return buf_[i_++];
+		}
+
+		// uniform in (0, 1) with 53 bits from two words
+		static double real(std::uint32_t a, std::uint32_t b)
+		{
+			return ((a >> 5)*67108864. + (b >> 6) + 0.5)/9007199254740992.;
+		}
+		double real(void)
+		{
+			std::uint32_t a = operator()();
+
+			return real(a, operator()());
+		}
+
+		// n uniforms in (0, 1), the same values as n calls to real().
+		// Whole blocks are generated independently of each other from the block index.
+		void real(std::size_t n, double* u)
+		{
+			std::size_t i = 0;
+
+			for (; i < n && i_ != 4; ++i)
+				u[i] = real();
+
+			std::uint64_t b = (static_cast<std::uint64_t>(ctr_[1]) << 32) | ctr_[0];
+			std::size_t m = (n - i)/2;
+			for (std::size_t j = 0; j < m; ++j) {
+				std::uint64_t bj = b + j;
+				std::uint32_t c[4] = {static_cast<std::uint32_t>(bj), static_cast<std::uint32_t>(bj >> 32), ctr_[2], ctr_[3]};
+				std::uint32_t w[4];
+				block(c, key_, w);
+				u[i + 2*j] = real(w[0], w[1]);
+				u[i + 2*j + 1] = real(w[2], w[3]);
+			}
+			seek(b + m);
+			i += 2*m;
+
+			for (; i < n; ++i)
+				u[i] = real();
+		}
+	};
+
+} // namespace rng
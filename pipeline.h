@@ -0,0 +1,489 @@
+// pipeline.h - reprice on every tick in stages connected by lock-free queues.
+// ingest -> implied volatility -> greeks -> portfolio
+// The caller's thread ingests. Instrument i is solved by implied volatility worker i % solvers and its
+// greeks by worker i % greeks, so each instrument stays in order. Ticks that arrive while an
+// instrument waits to be solved replace the waiting one (conflation), so a slow solve never
+// builds a backlog of stale prices. Latency is from push to the portfolio update.
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "black.h"
+#include "statistics.h"
+
+namespace pipeline {
+
+	typedef std::chrono::steady_clock clock;
+
+	// padding that keeps the indices of producers and consumers on different cache lines
+	// without over-aligned new, which C++14 lacks
+	struct pad {
+		char x[64];
+	};
+
+	// Bounded single producer, single consumer ring. Each side caches the other's index
+	// so it only reads the shared one when the ring looks full or empty.
+	template<class T>
+	class spsc {
+		std::vector<T> buf_;
+		std::size_t mask_;
+		pad pad0_;
+		std::atomic<std::size_t> head_; // next to pop
+		std::size_t tail_cache_;
+		pad pad1_;
+		std::atomic<std::size_t> tail_; // next to push
+		std::size_t head_cache_;
+		pad pad2_;
+	public:
+		// capacity is rounded up to a power of 2
+		explicit spsc(std::size_t capacity = 1024)
+			: head_(0), tail_cache_(0), tail_(0), head_cache_(0)
+		{
+			std::size_t n = 1;
+			while (n < capacity)
+				n <<= 1;
+			buf_.resize(n);
+			mask_ = n - 1;
+		}
+		spsc(const spsc&) = delete;
+		spsc& operator=(const spsc&) = delete;
+
+		bool push(const T& x)
+		{
+			std::size_t t = tail_.load(std::memory_order_relaxed);
+
+			if (t - head_cache_ > mask_) {
+				head_cache_ = head_.load(std::memory_order_acquire);
+				if (t - head_cache_ > mask_)
+					return false;
+			}
+			buf_[t & mask_] = x;
+			tail_.store(t + 1, std::memory_order_release);
+
+			return true;
+		}
+		bool pop(T& x)
+		{
+			std::size_t h = head_.load(std::memory_order_relaxed);
+
+			if (h == tail_cache_) {
+				tail_cache_ = tail_.load(std::memory_order_acquire);
+				if (h == tail_cache_)
+					return false;
+			}
+			x = buf_[h & mask_];
+			head_.store(h + 1, std::memory_order_release);
+
+			return true;
+		}
+	};
+
+	// Bounded multiple producer, single consumer ring. Producers claim a cell by advancing the tail
+	// and each cell's sequence number says whether it is free, full, or still being written
+	// (Vyukov's bounded queue with the consumer side simplified to one thread).
+	template<class T>
+	class mpsc {
+		struct cell {
+			std::atomic<std::size_t> seq;
+			T x;
+		};
+		std::unique_ptr<cell[]> buf_;
+		std::size_t mask_;
+		pad pad0_;
+		std::atomic<std::size_t> tail_;
+		pad pad1_;
+		std::size_t head_;
+		pad pad2_;
+	public:
+		explicit mpsc(std::size_t capacity = 1024)
+			: tail_(0), head_(0)
+		{
+			std::size_t n = 1;
+			while (n < capacity)
+				n <<= 1;
+			buf_.reset(new cell[n]);
+			for (std::size_t i = 0; i < n; ++i)
+				buf_[i].seq.store(i, std::memory_order_relaxed);
+			mask_ = n - 1;
+		}
+		mpsc(const mpsc&) = delete;
+		mpsc& operator=(const mpsc&) = delete;
+
+		bool push(const T& x)
+		{
+			std::size_t t = tail_.load(std::memory_order_relaxed);
+
+			for (;;) {
+				cell& c = buf_[t & mask_];
+				std::ptrdiff_t d = static_cast<std::ptrdiff_t>(c.seq.load(std::memory_order_acquire) - t);
+				if (d == 0) {
+					if (tail_.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+						c.x = x;
+						c.seq.store(t + 1, std::memory_order_release);
+
+						return true;
+					}
+				}
+				else if (d < 0) {
+					return false; // full
+				}
+				else {
+					t = tail_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+		bool pop(T& x)
+		{
+			cell& c = buf_[head_ & mask_];
+
+			if (c.seq.load(std::memory_order_acquire) != head_ + 1)
+				return false;
+			x = c.x;
+			c.seq.store(head_ + mask_ + 1, std::memory_order_release);
+			++head_;
+
+			return true;
+		}
+	};
+
+	// market data for one option, puts have negative strikes
+	struct tick {
+		std::size_t instrument;
+		double forward, price, strike, expiration;
+		double time;            // seconds from the start of a replay
+		clock::time_point push; // set by engine::push
+	};
+
+	// implied volatility and greeks of the last tick priced
+	struct greeks {
+		std::size_t instrument;
+		double forward, volatility, strike, expiration;
+		double value, delta, gamma, vega, theta;
+		clock::time_point push;
+	};
+
+	// portfolio sums of quantity times each greek
+	struct totals {
+		double value, delta, gamma, vega, theta;
+	};
+
+	class engine {
+		// Latest tick of an instrument as a triple buffer: ingest writes back and swaps it with middle,
+		// the solver swaps middle with front when middle is newer. Neither side ever waits.
+		// middle and queued are sequentially consistent so a solver that clears queued and then finds
+		// nothing fresh is certain the next put will see queued clear and queue the instrument again.
+		struct slot {
+			tick buf[3];
+			std::atomic<unsigned> middle; // index, plus fresh when ingest has written since the last take
+			unsigned back, front;
+			std::atomic<bool> queued;     // instrument is in its solver's queue
+			double volatility;            // seed for the next solve, owned by the solver
+			enum { fresh = 4 };
+
+			slot()
+				: middle(1), back(0), front(2), queued(false), volatility(.2)
+			{ }
+			void put(const tick& t)
+			{
+				buf[back] = t;
+				back = middle.exchange(back | fresh) & 3;
+			}
+			bool take(tick& t)
+			{
+				if (!(middle.load() & fresh))
+					return false;
+				front = middle.exchange(front) & 3;
+				t = buf[front];
+
+				return true;
+			}
+		};
+
+		std::vector<slot> slot_;
+		std::vector<double> quantity_;
+		std::vector<std::unique_ptr<spsc<std::size_t> > > solve_q_;
+		std::vector<std::unique_ptr<mpsc<greeks> > > greeks_q_;
+		mpsc<greeks> portfolio_q_;
+		std::vector<std::thread> thread_;
+		std::atomic<bool> ingest_done_;
+		std::atomic<std::size_t> solvers_done_, greeks_done_;
+		std::atomic<std::size_t> pushed_, solved_, failed_, stale_;
+
+		// results, owned by the portfolio thread until stop
+		std::vector<greeks> last_;
+		std::vector<bool> priced_;
+		totals totals_;
+		statistics::digest latency_;
+
+		// wait for room
+		template<class Q, class T>
+		static void enqueue(Q& q, const T& x)
+		{
+			while (!q.push(x))
+				std::this_thread::yield();
+		}
+
+		void solve(std::size_t w)
+		{
+			spsc<std::size_t>& q = *solve_q_[w];
+			std::size_t i;
+			tick t;
+
+			for (;;) {
+				bool done = ingest_done_.load(std::memory_order_acquire);
+				if (!q.pop(i)) {
+					if (done)
+						break;
+					std::this_thread::yield();
+					continue;
+				}
+
+				// clear before taking so a tick that lands after the take queues the instrument again
+				slot& s = slot_[i];
+				s.queued.store(false);
+				if (!s.take(t)) {
+					++stale_;
+					continue;
+				}
+
+				// prices outside the no arbitrage bounds have no volatility
+				if (!black::implied_in_bounds(t.forward, t.price, t.strike, t.expiration)) {
+					++failed_;
+					continue;
+				}
+
+				greeks g;
+				g.instrument = i;
+				g.forward = t.forward;
+				g.strike = t.strike;
+				g.expiration = t.expiration;
+				g.push = t.push;
+				if (black::implied_solve(t.forward, t.price, t.strike, t.expiration, s.volatility, 1e-10, 100, &g.volatility) != black::implied_ok) {
+					++failed_;
+					continue;
+				}
+				s.volatility = g.volatility;
+				++solved_;
+				enqueue(*greeks_q_[i % greeks_q_.size()], g);
+			}
+			++solvers_done_;
+		}
+
+		void price(std::size_t w)
+		{
+			mpsc<greeks>& q = *greeks_q_[w];
+			greeks g;
+
+			for (;;) {
+				bool done = solvers_done_.load(std::memory_order_acquire) == solve_q_.size();
+				if (!q.pop(g)) {
+					if (done)
+						break;
+					std::this_thread::yield();
+					continue;
+				}
+
+				g.value = black::greeks(g.forward, g.volatility, g.strike, g.expiration, &g.delta, &g.gamma, &g.vega, &g.theta);
+				enqueue(portfolio_q_, g);
+			}
+			++greeks_done_;
+		}
+
+		void aggregate(void)
+		{
+			greeks g;
+
+			for (;;) {
+				bool done = greeks_done_.load(std::memory_order_acquire) == greeks_q_.size();
+				if (!portfolio_q_.pop(g)) {
+					if (done)
+						break;
+					std::this_thread::yield();
+					continue;
+				}
+
+				// replace the instrument's last contribution
+				std::size_t i = g.instrument;
+				double q = quantity_[i];
+				if (priced_[i]) {
+					const greeks& h = last_[i];
+					totals_.value -= q*h.value;
+					totals_.delta -= q*h.delta;
+					totals_.gamma -= q*h.gamma;
+					totals_.vega -= q*h.vega;
+					totals_.theta -= q*h.theta;
+				}
+				totals_.value += q*g.value;
+				totals_.delta += q*g.delta;
+				totals_.gamma += q*g.gamma;
+				totals_.vega += q*g.vega;
+				totals_.theta += q*g.theta;
+				last_[i] = g;
+				priced_[i] = true;
+
+				latency_.add(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - g.push).count()));
+			}
+		}
+	public:
+		// solvers and greeks are the number of worker threads in each stage
+		engine(std::size_t instruments, std::size_t solvers = 1, std::size_t greeks = 1, std::size_t capacity = 1024)
+			: slot_(instruments), quantity_(instruments, 1), portfolio_q_(capacity),
+			  ingest_done_(false), solvers_done_(0), greeks_done_(0),
+			  pushed_(0), solved_(0), failed_(0), stale_(0),
+			  last_(instruments), priced_(instruments, false)
+		{
+			ensure (instruments > 0 && solvers > 0 && greeks > 0);
+
+			// every instrument can be queued at once, so ingest never waits on a solver
+			for (std::size_t w = 0; w < solvers; ++w)
+				solve_q_.emplace_back(new spsc<std::size_t>(instruments/solvers + 1));
+			for (std::size_t w = 0; w < greeks; ++w)
+				greeks_q_.emplace_back(new mpsc<pipeline::greeks>(capacity));
+
+			totals_.value = totals_.delta = totals_.gamma = totals_.vega = totals_.theta = 0;
+		}
+		engine(const engine&) = delete;
+		engine& operator=(const engine&) = delete;
+		~engine()
+		{
+			if (!thread_.empty())
+				stop();
+		}
+
+		// quantity held of instrument i, 1 by default, set before start
+		engine& position(std::size_t i, double quantity)
+		{
+			ensure (i < quantity_.size() && thread_.empty());
+			quantity_[i] = quantity;
+
+			return *this;
+		}
+
+		void start(void)
+		{
+			ensure (thread_.empty());
+
+			for (std::size_t w = 0; w < solve_q_.size(); ++w)
+				thread_.emplace_back(&engine::solve, this, w);
+			for (std::size_t w = 0; w < greeks_q_.size(); ++w)
+				thread_.emplace_back(&engine::price, this, w);
+			thread_.emplace_back(&engine::aggregate, this);
+		}
+
+		// called from one ingest thread after start
+		void push(tick t)
+		{
+			ensure (t.instrument < slot_.size());
+
+			slot& s = slot_[t.instrument];
+			t.push = clock::now();
+			s.put(t);
+			++pushed_;
+			if (!s.queued.exchange(true))
+				enqueue(*solve_q_[t.instrument % solve_q_.size()], t.instrument);
+		}
+
+		// finish every tick pushed and join the workers
+		void stop(void)
+		{
+			ingest_done_ = true;
+			for (std::size_t i = 0; i < thread_.size(); ++i)
+				thread_[i].join();
+			thread_.clear();
+		}
+
+		// after stop
+		std::size_t pushed(void) const
+		{
+			return pushed_;
+		}
+		// ticks priced, failed to solve, or replaced by a later tick of the same instrument
+		std::size_t solved(void) const
+		{
+			return solved_;
+		}
+		std::size_t failed(void) const
+		{
+			return failed_;
+		}
+		std::size_t conflated(void) const
+		{
+			return pushed_ - solved_ - failed_;
+		}
+		// queue entries whose tick had already been taken
+		std::size_t stale(void) const
+		{
+			return stale_;
+		}
+		const totals& portfolio(void) const
+		{
+			return totals_;
+		}
+		// last greeks of instrument i, if it was ever priced
+		bool last(std::size_t i, greeks& g) const
+		{
+			if (!priced_[i])
+				return false;
+			g = last_[i];
+
+			return true;
+		}
+		// nanoseconds from push to portfolio update, a copy since reading quantiles compresses the digest
+		statistics::digest latency(void) const
+		{
+			return latency_;
+		}
+	};
+
+	// Ticks from a file with one "time,instrument,forward,price,strike,expiration" line per tick,
+	// time in seconds from the start. Lines starting with # are skipped.
+	inline std::vector<tick> read(const char* file)
+	{
+		std::vector<tick> ts;
+		FILE* fp = fopen(file, "r");
+
+		if (!fp)
+			throw std::runtime_error(std::string("pipeline::read: cannot open ") + file);
+
+		char line[256];
+		while (fgets(line, sizeof(line), fp)) {
+			if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+				continue;
+
+			tick t;
+			unsigned long i;
+			if (sscanf(line, "%lf,%lu,%lf,%lf,%lf,%lf", &t.time, &i, &t.forward, &t.price, &t.strike, &t.expiration) != 6) {
+				fclose(fp);
+				throw std::runtime_error(std::string("pipeline::read: bad line ") + line);
+			}
+			t.instrument = i;
+			ts.push_back(t);
+		}
+		fclose(fp);
+
+		return ts;
+	}
+
+	// Push ticks into e at speed times their recorded pace, or as fast as possible if speed is 0.
+	inline void replay(engine& e, const std::vector<tick>& ts, double speed = 0)
+	{
+		clock::time_point t0 = clock::now();
+
+		for (std::size_t i = 0; i < ts.size(); ++i) {
+			if (speed > 0) {
+				clock::time_point due = t0 + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(ts[i].time/speed));
+				while (clock::now() < due)
+					std::this_thread::yield();
+			}
+			e.push(ts[i]);
+		}
+	}
+
+} // namespace pipeline
@@ -0,0 +1,53 @@
+// smile.h - price option chains under any model and invert to Black implied volatilities.
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "black.h"
+#include "parallel.h"
+
+namespace smile {
+
+	// options on one forward with one expiration, negative strikes are puts
+	struct chain {
+		double f;
+		double t;
+		std::vector<double> k;
+		chain(double forward, double expiration, const std::vector<double>& strike)
+			: f(forward), t(expiration), k(strike)
+		{ }
+	};
+
+	// model prices, implied volatilities and black::implied_status for each strike
+	struct result {
+		std::vector<double> price;
+		std::vector<double> vol;
+		std::vector<int> status;
+	};
+
+	// Price every chain with pricer(const chain& c, double* price), which writes one
+	// price per strike in c.k, then invert to implied volatilities. Chains run in
+	// parallel on the pool, each chain in a single thread, so the pricer must be
+	// safe to call concurrently on different chains. As in black::black, negative
+	// strikes are puts so the pricer must return put values for them.
+	template<class Pricer>
+	inline std::vector<result> implied(const Pricer& pricer, const std::vector<chain>& c, parallel::pool& pool)
+	{
+		std::vector<result> r(c.size());
+
+		pool.run(c.size(), [&](std::size_t i) {
+			std::size_t n = c[i].k.size();
+
+			r[i].price.resize(n);
+			r[i].vol.resize(n);
+			r[i].status.resize(n);
+			if (n == 0)
+				return;
+
+			pricer(c[i], &r[i].price[0]);
+			black::implied_volatility(c[i].f, n, &r[i].price[0], &c[i].k[0], c[i].t, &r[i].vol[0], &r[i].status[0]);
+		});
+
+		return r;
+	}
+
+} // namespace smile
@@ -34,6 +34,13 @@ struct standard_brownian : public base_distribution<R,T> { // B_t
 		return t_*s*s/2.;
 	}
 
+	// characteristic function E[exp(iu B_t)], also for complex u as used by cosine::price
+	template<class U>
+	U characteristic(const U& u) const
+	{
+		return exp(-t_*u*u/2.);
+	}
+
 	// cumulant distribution function
 	// log E[exp(sB_t) 1(B_t <= x)] = s^2t/2 + log P(X_t + st <= z)
 	template<class U, class V>
@@ -0,0 +1,276 @@
+// statistics.h - streaming moments and quantiles that can be merged across threads.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#ifndef ensure
+#include <cassert>
+#define ensure(x) assert(x)
+#endif
+
+namespace statistics {
+
+	// Count, mean, central moments to fourth order and range in one pass.
+	// Welford updates for add and Pebay 2008, "Formulas for robust, one-pass parallel computation
+	// of covariances and arbitrary-order statistical moments", for merge. Merging in a fixed order
+	// gives the same result however the samples were split.
+	class moments {
+		double n_, m1_, m2_, m3_, m4_; // m2_, m3_, m4_ are sums of powers of deviations
+		double min_, max_;
+	public:
+		moments()
+			: n_(0), m1_(0), m2_(0), m3_(0), m4_(0),
+			  min_(std::numeric_limits<double>::infinity()), max_(-std::numeric_limits<double>::infinity())
+		{ }
+
+		void add(double x)
+		{
+			double n1 = n_;
+			n_ += 1;
+
+			double d = x - m1_, dn = d/n_, dn2 = dn*dn, t = d*dn*n1;
+
+			m1_ += dn;
+			m4_ += t*dn2*(n_*n_ - 3*n_ + 3) + 6*dn2*m2_ - 4*dn*m3_;
+			m3_ += t*dn*(n_ - 2) - 3*dn*m2_;
+			m2_ += t;
+			min_ = std::min(min_, x);
+			max_ = std::max(max_, x);
+		}
+		void add(std::size_t n, const double* x)
+		{
+			for (std::size_t i = 0; i < n; ++i)
+				add(x[i]);
+		}
+		void merge(const moments& b)
+		{
+			if (b.n_ == 0)
+				return;
+			if (n_ == 0) {
+				*this = b;
+
+				return;
+			}
+
+			double na = n_, nb = b.n_, n = na + nb;
+			double d = b.m1_ - m1_, d2 = d*d;
+
+			m4_ += b.m4_ + d2*d2*na*nb*(na*na - na*nb + nb*nb)/(n*n*n)
+				+ 6*d2*(na*na*b.m2_ + nb*nb*m2_)/(n*n) + 4*d*(na*b.m3_ - nb*m3_)/n;
+			m3_ += b.m3_ + d2*d*na*nb*(na - nb)/(n*n) + 3*d*(na*b.m2_ - nb*m2_)/n;
+			m2_ += b.m2_ + d2*na*nb/n;
+			m1_ += d*nb/n;
+			n_ = n;
+			min_ = std::min(min_, b.min_);
+			max_ = std::max(max_, b.max_);
+		}
+
+		std::size_t count(void) const
+		{
+			return static_cast<std::size_t>(n_);
+		}
+		double mean(void) const
+		{
+			return m1_;
+		}
+		// unbiased
+		double variance(void) const
+		{
+			return n_ > 1 ? m2_/(n_ - 1) : 0;
+		}
+		double stddev(void) const
+		{
+			return sqrt(variance());
+		}
+		// standard error of the mean
+		double error(void) const
+		{
+			return n_ > 1 ? sqrt(variance()/n_) : 0;
+		}
+		double skewness(void) const
+		{
+			return m2_ > 0 ? sqrt(n_)*m3_/pow(m2_, 1.5) : 0;
+		}
+		// excess kurtosis
+		double kurtosis(void) const
+		{
+			return m2_ > 0 ? n_*m4_/(m2_*m2_) - 3 : 0;
+		}
+		double min(void) const
+		{
+			return min_;
+		}
+		double max(void) const
+		{
+			return max_;
+		}
+		// first four cumulants: mean, mu2, mu3, mu4 - 3 mu2^2, as in jr::kappa
+		std::vector<double> kappa(void) const
+		{
+			std::vector<double> k(4, 0.);
+
+			if (n_ == 0)
+				return k;
+
+			double mu2 = m2_/n_;
+			k[0] = m1_;
+			k[1] = mu2;
+			k[2] = m3_/n_;
+			k[3] = m4_/n_ - 3*mu2*mu2;
+
+			return k;
+		}
+	};
+
+	// Merging t-digest for quantiles in bounded memory.
+	// Dunning and Ertl 2019, "Computing extremely accurate quantiles using t-digests".
+	// Centroids are limited by the scale function k(q) = delta/(4 log(n/delta) + 24) log(q/(1 - q)),
+	// so they are small in the tails, and O(delta) are kept however many samples are added.
+	// Points are buffered and sorted with their weights, so the result depends only on the
+	// order of add and merge calls. Reading quantiles merges the buffer, so readers are not const
+	// and a digest shared between threads needs the same locking as add.
+	class digest {
+		double delta_;
+		struct centroid {
+			double mean, weight;
+			bool operator<(const centroid& c) const
+			{
+				return mean < c.mean || (mean == c.mean && weight < c.weight);
+			}
+		};
+		std::vector<centroid> c_, b_; // centroids and unmerged buffer
+		double n_, min_, max_;
+
+		double k(double q, double n) const
+		{
+			q = std::min(std::max(q, 1e-15), 1 - 1e-15);
+
+			return delta_/(4*log(std::max(n/delta_, 1.)) + 24)*log(q/(1 - q));
+		}
+	public:
+		explicit digest(double delta = 500)
+			: delta_(delta), n_(0),
+			  min_(std::numeric_limits<double>::infinity()), max_(-std::numeric_limits<double>::infinity())
+		{
+			ensure (delta > 1);
+		}
+
+		void add(double x, double w = 1)
+		{
+			centroid c = {x, w};
+
+			b_.push_back(c);
+			n_ += w;
+			min_ = std::min(min_, x);
+			max_ = std::max(max_, x);
+			if (b_.size() >= static_cast<std::size_t>(5*delta_))
+				compress();
+		}
+		void add(std::size_t n, const double* x)
+		{
+			for (std::size_t i = 0; i < n; ++i)
+				add(x[i]);
+		}
+		// merge the buffer into the centroids, done automatically when it fills
+		void compress(void)
+		{
+			if (b_.empty())
+				return;
+
+			b_.insert(b_.end(), c_.begin(), c_.end());
+			std::sort(b_.begin(), b_.end());
+			c_.clear();
+
+			double w = 0, total = 0;
+			for (std::size_t i = 0; i < b_.size(); ++i)
+				total += b_[i].weight;
+
+			centroid cur = b_[0];
+			double klo = k(0, total);
+			for (std::size_t i = 1; i < b_.size(); ++i) {
+				double q = (w + cur.weight + b_[i].weight)/total;
+				if (k(q, total) - klo <= 1) {
+					cur.weight += b_[i].weight;
+					cur.mean += (b_[i].mean - cur.mean)*b_[i].weight/cur.weight;
+				}
+				else {
+					w += cur.weight;
+					klo = k(w/total, total);
+					c_.push_back(cur);
+					cur = b_[i];
+				}
+			}
+			c_.push_back(cur);
+			b_.clear();
+		}
+		void merge(const digest& d)
+		{
+			b_.insert(b_.end(), d.c_.begin(), d.c_.end());
+			b_.insert(b_.end(), d.b_.begin(), d.b_.end());
+			n_ += d.n_;
+			min_ = std::min(min_, d.min_);
+			max_ = std::max(max_, d.max_);
+			compress();
+		}
+
+		double count(void) const
+		{
+			return n_;
+		}
+		std::size_t size(void)
+		{
+			compress();
+
+			return c_.size();
+		}
+
+		// x with P(X <= x) = q, interpolating between centroid means and the sample range at the ends
+		double quantile(double q)
+		{
+			ensure (0 <= q && q <= 1);
+
+			compress();
+			if (c_.empty())
+				return std::numeric_limits<double>::quiet_NaN();
+
+			double t = q*n_, w = 0;
+			double x0 = min_, t0 = 0;
+			for (std::size_t i = 0; i < c_.size(); ++i) {
+				double ti = w + c_[i].weight/2;
+				if (t < ti)
+					return x0 + (t - t0)*(c_[i].mean - x0)/(ti - t0);
+				x0 = c_[i].mean;
+				t0 = ti;
+				w += c_[i].weight;
+			}
+
+			return t0 < n_ ? x0 + (t - t0)*(max_ - x0)/(n_ - t0) : max_;
+		}
+		// P(X <= x), the inverse of quantile
+		double cdf(double x)
+		{
+			compress();
+			if (c_.empty() || x < min_)
+				return 0;
+			if (x >= max_)
+				return 1;
+
+			double w = 0;
+			double x0 = min_, t0 = 0;
+			for (std::size_t i = 0; i < c_.size(); ++i) {
+				double ti = w + c_[i].weight/2;
+				if (x < c_[i].mean)
+					return (t0 + (x - x0)*(ti - t0)/(c_[i].mean - x0))/n_;
+				x0 = c_[i].mean;
+				t0 = ti;
+				w += c_[i].weight;
+			}
+
+			return (t0 + (x - x0)*(n_ - t0)/(max_ - x0))/n_;
+		}
+	};
+
+} // namespace statistics
@@ -0,0 +1,41 @@
+// stats.cpp - C interface to the call statistics in stats.h.
+#include "bms_c.h"
+#include "stats.h"
+
+static stats::counter* find(std::size_t i)
+{
+	for (stats::counter* c = stats::counter::first(); c; c = c->next())
+		if (c->id() == i)
+			return c;
+
+	return 0;
+}
+
+extern "C" std::size_t bms_stats_count(void)
+{
+	return stats::counter::count();
+}
+
+extern "C" int bms_stats_get(std::size_t i, bms_stats_entry* e)
+{
+	const stats::counter* c = find(i);
+	if (!c || !e)
+		return -1;
+
+	stats::counter::snapshot s = c->read();
+	e->name = c->name();
+	e->calls = s.calls;
+	e->seconds = s.seconds();
+	e->mean = s.mean();
+	e->p50 = s.quantile(.5);
+	e->p99 = s.quantile(.99);
+	e->max = s.max*1e-9;
+
+	return 0;
+}
+
+extern "C" void bms_stats_reset(void)
+{
+	for (stats::counter* c = stats::counter::first(); c; c = c->next())
+		c->reset();
+}
@@ -0,0 +1,204 @@
+// stats.h - call counts and latency histograms for add-in functions.
+// Put BMS_STATS_SCOPE("NAME") at the top of a function body to time each call. Unless BMS_STATS
+// is defined the macro expands to nothing, so instrumented functions compile to the same code.
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef BMS_STATS
+#define BMS_STATS_SCOPE(name) \
+	static stats::counter bms_stats_counter_(name); \
+	stats::scope bms_stats_scope_(bms_stats_counter_)
+#else
+#define BMS_STATS_SCOPE(name) ((void)0)
+#endif
+
+namespace stats {
+
+	// Calls and nanoseconds of one function. Each thread updates its own stripe with relaxed atomic
+	// adds, so recording never takes a lock and threads do not share cache lines unless there are more
+	// threads than stripes. Readers sum the stripes without stopping writers.
+	class counter {
+	public:
+		enum { stripes = 16 };
+		enum { buckets = 40 }; // bucket b holds calls of [2^b, 2^(b+1)) ns, the last one is open
+
+		// sums over stripes at one time
+		struct snapshot {
+			std::uint64_t calls, ns, max;
+			std::uint64_t histogram[buckets];
+
+			double seconds(void) const
+			{
+				return ns*1e-9;
+			}
+			double mean(void) const
+			{
+				return calls ? seconds()/calls : 0;
+			}
+			// seconds below which a fraction p of calls took, interpolated geometrically within a bucket
+			double quantile(double p) const
+			{
+				if (calls == 0)
+					return 0;
+
+				double n = p*calls, m = 0;
+				for (int b = 0; b < buckets; ++b) {
+					if (histogram[b] && m + histogram[b] >= n) {
+						double lo = static_cast<double>(std::uint64_t(1) << b);
+						double q = lo*std::exp2((n - m)/histogram[b]);
+						double hi = static_cast<double>(max);
+
+						return (q < hi ? q : hi)*1e-9;
+					}
+					m += histogram[b];
+				}
+
+				return max*1e-9;
+			}
+		};
+	private:
+		struct alignas(64) stripe {
+			std::atomic<std::uint64_t> calls, ns, max;
+			std::atomic<std::uint64_t> histogram[buckets];
+		};
+		const char* name_;
+		std::size_t id_;
+		counter* next_;
+		stripe s_[stripes];
+
+		static std::atomic<counter*>& head(void)
+		{
+			static std::atomic<counter*> h(nullptr);
+
+			return h;
+		}
+		// small per-thread number used to pick a stripe
+		static std::size_t thread_index(void)
+		{
+			static std::atomic<std::size_t> n(0);
+			thread_local std::size_t i = n++;
+
+			return i;
+		}
+		static int bucket(std::uint64_t ns)
+		{
+			int b = 0;
+
+			while (ns >>= 1)
+				++b;
+
+			return b < buckets ? b : buckets - 1;
+		}
+	public:
+		// name must outlive the counter, usually a string literal
+		explicit counter(const char* name)
+			: name_(name)
+		{
+			reset();
+
+			// Counters are only added, so pushing on the front of a list needs no lock. The id is one
+			// more than the id of the counter it is pushed in front of, so the ids of the list are
+			// always 0, ..., count() - 1 and a counter is linked as soon as count() includes it.
+			next_ = head().load();
+			do {
+				id_ = next_ ? next_->id_ + 1 : 0;
+			} while (!head().compare_exchange_weak(next_, this));
+		}
+		counter(const counter&) = delete;
+		counter& operator=(const counter&) = delete;
+
+		const char* name(void) const
+		{
+			return name_;
+		}
+		// order in which counters were linked
+		std::size_t id(void) const
+		{
+			return id_;
+		}
+
+		void add(std::uint64_t ns)
+		{
+			stripe& s = s_[thread_index() % stripes];
+
+			s.calls.fetch_add(1, std::memory_order_relaxed);
+			s.ns.fetch_add(ns, std::memory_order_relaxed);
+			s.histogram[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+			std::uint64_t m = s.max.load(std::memory_order_relaxed);
+			while (ns > m && !s.max.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+				;
+		}
+
+		snapshot read(void) const
+		{
+			snapshot r = {0, 0, 0, {0}};
+
+			for (int i = 0; i < stripes; ++i) {
+				const stripe& s = s_[i];
+				r.calls += s.calls.load(std::memory_order_relaxed);
+				r.ns += s.ns.load(std::memory_order_relaxed);
+				std::uint64_t m = s.max.load(std::memory_order_relaxed);
+				if (m > r.max)
+					r.max = m;
+				for (int b = 0; b < buckets; ++b)
+					r.histogram[b] += s.histogram[b].load(std::memory_order_relaxed);
+			}
+
+			return r;
+		}
+		// calls in progress may land on either side of a reset
+		void reset(void)
+		{
+			for (int i = 0; i < stripes; ++i) {
+				stripe& s = s_[i];
+				s.calls.store(0, std::memory_order_relaxed);
+				s.ns.store(0, std::memory_order_relaxed);
+				s.max.store(0, std::memory_order_relaxed);
+				for (int b = 0; b < buckets; ++b)
+					s.histogram[b].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		// every counter, most recently constructed first
+		static counter* first(void)
+		{
+			return head().load();
+		}
+		counter* next(void) const
+		{
+			return next_;
+		}
+		static std::size_t count(void)
+		{
+			counter* h = first();
+
+			return h ? h->id() + 1 : 0;
+		}
+	};
+
+	// record the time from construction to destruction
+	class scope {
+		counter& c_;
+		std::chrono::steady_clock::time_point t0_;
+	public:
+		explicit scope(counter& c)
+			: c_(c), t0_(std::chrono::steady_clock::now())
+		{ }
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+		~scope()
+		{
+			std::chrono::steady_clock::duration dt = std::chrono::steady_clock::now() - t0_;
+			c_.add(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count()));
+		}
+	};
+
+} // namespace stats
+
+// The C interface, bms_stats_count, bms_stats_get and bms_stats_reset, is declared in bms_c.h
+// and defined in stats.cpp.
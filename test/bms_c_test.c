@@ -0,0 +1,111 @@
+/* bms_c_test.c - call the C interface from C, linked against libbms.so. */
+#include <math.h>
+#include <stdio.h>
+#include "bms_c.h"
+
+static int failures = 0;
+
+#define check(e) do { if (!(e)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #e); ++failures; } } while (0)
+
+static int close(double x, double y, double eps)
+{
+	return fabs(x - y) <= eps*(1 + fabs(y));
+}
+
+static void test_black(void)
+{
+	double f[] = {100, 100, 100}, s[] = {.2, .2, .3}, k[] = {90, -100, 110}, t[] = {.25, .5, 1};
+	double v[3], df[3], ddf[3], ds[3], dt[3], x, dx, vol[3];
+	int i, st[3];
+
+	check (bms_black_greeks_n(3, f, s, k, t, v, df, ddf, ds, dt) == BMS_OK);
+	for (i = 0; i < 3; ++i) {
+		check (bms_black_greeks(f[i], s[i], k[i], t[i], &x, &dx, 0, 0, 0) == BMS_OK);
+		check (x == v[i] && dx == df[i]);
+	}
+	check (df[0] > 0 && df[1] < 0 && ddf[0] > 0 && ds[2] > 0);
+
+	check (bms_black_implied_volatility_n(100, 3, v, k, .25, vol, st) == BMS_OK);
+	check (st[0] == BMS_OK && close(vol[0], .2, 1e-8));
+
+	check (bms_black_implied_volatility(100, 1, 50, .25, &x) == BMS_DOMAIN);
+	check (bms_black_value(-1, .2, 100, .25, &x) == BMS_DOMAIN);
+	check (bms_black_value(100, .2, 100, .25, 0) == BMS_DOMAIN);
+}
+
+static void test_lkk(void)
+{
+	double x[] = {-.1, 0, .1}, y[3], p[3], z;
+	double k[] = {90, 100, 110};
+	int i;
+
+	check (bms_lkk_cdf_n(3, x, .2, .01, .01, y) == BMS_OK);
+	check (0 < y[0] && y[0] < y[1] && y[1] < y[2] && y[2] < 1);
+	check (bms_lkk_put_n(100, .2, .01, .01, 3, k, 1, p) == BMS_OK);
+	for (i = 0; i < 3; ++i) {
+		check (bms_lkk_put(100, .2, .01, .01, k[i], 1, &z) == BMS_OK);
+		check (close(z, p[i], 1e-14));
+	}
+	check (bms_lkk_pdf(0, .1, .01, .01, &z) == BMS_DOMAIN);
+}
+
+static void test_normalexp(void)
+{
+	double u[] = {.001, .5, .999}, x[3], y[3], p, q;
+	double v[999], z[999];
+	int i;
+
+	check (bms_normalexp_inv_n(3, u, -1.5, 2, x) == BMS_OK);
+	check (bms_normalexp_cdf_n(3, x, -1.5, 2, y) == BMS_OK);
+	check (close(y[0], u[0], 1e-10) && close(y[1], u[1], 1e-10) && close(y[2], u[2], 1e-10));
+
+	/* the inverse round trips through both tails and the body and is increasing */
+	for (i = 0; i < 999; ++i)
+		v[i] = (i + 1)/1000.;
+	check (bms_normalexp_inv_n(999, v, -1.5, 1.2, z) == BMS_OK);
+	for (i = 1; i < 999; ++i)
+		check (z[i - 1] < z[i]);
+	check (z[0] < -1.5 && z[998] > 1.2);
+	check (bms_normalexp_cdf_n(999, z, -1.5, 1.2, z) == BMS_OK);
+	for (i = 0; i < 999; ++i)
+		check (close(z[i], v[i], 1e-10));
+	check (bms_normalexp_pdf(0, -1.5, 2, &p) == BMS_OK && p > 0);
+	check (bms_normalexp_put(100, .2, 100, 1, -1.5, 2, &p) == BMS_OK);
+	check (bms_normalexp_put(100, .2, 100, 1, -3, 3, &q) == BMS_OK);
+	check (p > 0 && p < 100 && q > 0 && q < 100);
+	check (bms_normalexp_cdf(0, 1, 2, &p) == BMS_DOMAIN);
+}
+
+static void test_jr(void)
+{
+	double v;
+	int s = bms_jr_value(100, 0, 1, .2, 100, 0, 0, 0, &v);
+
+	check (s == BMS_OK || s == BMS_UNAVAILABLE);
+	if (s == BMS_UNAVAILABLE)
+		printf("%s\n", bms_status_string(s));
+}
+
+/* the library exports the stats interface, it has no timed functions */
+static void test_stats(void)
+{
+	bms_stats_entry e;
+
+	check (bms_stats_count() == 0);
+	check (bms_stats_get(0, &e) != 0);
+	bms_stats_reset();
+}
+
+int main(void)
+{
+	check (bms_version() >= 2);
+	test_black();
+	test_lkk();
+	test_normalexp();
+	test_jr();
+	test_stats();
+
+	printf("%s: %d failure%s\n", failures ? "FAILED" : "passed", failures, failures == 1 ? "" : "s");
+
+	return failures != 0;
+}
@@ -0,0 +1,927 @@
+// harness.cpp - call the add-in entry points through the fake XLOPER layer in test/xll.
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+// the Sobol cross-check against Boost is skipped when Boost is not installed
+#if defined(__has_include)
+#if __has_include(<boost/random/sobol.hpp>)
+#include <boost/random/sobol.hpp>
+#define HAVE_BOOST_SOBOL
+#endif
+#endif
+#include "xll/xll.h"
+#include "../black.h"
+#include "../memo.h"
+#include "../bms_c.h"
+#include "../stats.h"
+#include "../pipeline.h"
+#include "../lkk.h"
+#include "../fft.h"
+#include "../smile.h"
+#include "../philox.h"
+#include "../hedge.h"
+#include "../brownian.h"
+#include "../sobol.h"
+#include "../montecarlo.h"
+#include "../cosine.h"
+#include "../statistics.h"
+
+using namespace xll;
+
+typedef traits<XLOPERX>::xfp xfp;
+
+double WINAPI xll_black_value(double f, double sigma, double k, double t);
+double WINAPI xll_black_delta(double f, double sigma, double k, double t);
+double WINAPI xll_black_implied_volatility(double f, double p, double k, double t);
+xfp* WINAPI xll_black_greeks(double f, double sigma, double k, double t);
+xfp* WINAPI xll_black_value_array(xfp* pf, xfp* ps, xfp* pk, xfp* pt);
+xfp* WINAPI xll_black_greeks_array(xfp* pf, xfp* ps, xfp* pk, xfp* pt);
+xfp* WINAPI xll_black_implied_volatility_array(double f, xfp* pp, xfp* pk, double t);
+xfp* WINAPI xll_lkk_cdf(xfp* px, double s, double a, double b);
+double WINAPI xll_lkk_put(double f, double s, double a, double b, double k, double t);
+BOOL WINAPI xll_memo_enable(const char* name, BOOL b);
+xfp* WINAPI xll_memo_stats(const char* name);
+LPOPERX WINAPI xll_bms_stats(BOOL reset);
+#ifdef BLACK_IMPLIED_TELEMETRY
+xfp* WINAPI xll_black_implied_telemetry(BOOL reset);
+#endif
+
+// test/jiejie.cpp, returns its failure count
+int test_jiejie(void);
+
+static int failures = 0;
+
+#define check(e) do { if (!(e)) { std::printf("%s:%d: %s\n", __FILE__, __LINE__, #e); ++failures; } } while (0)
+
+static bool close(double x, double y, double eps = 1e-12)
+{
+	return fabs(x - y) <= eps*(1 + fabs(y));
+}
+
+static FPX column(const std::vector<double>& x)
+{
+	FPX a(static_cast<unsigned short>(x.size()), 1);
+
+	for (unsigned short i = 0; i < a.size(); ++i)
+		a[i] = x[i];
+
+	return a;
+}
+
+static void test_registry(void)
+{
+	const std::vector<registration>& r = registry();
+
+	check (r.size() > 0);
+	for (std::size_t i = 0; i < r.size(); ++i) {
+		if (!r[i].thread_safe)
+			std::printf("not thread safe: %s\n", r[i].name.c_str());
+		check (r[i].thread_safe);
+	}
+}
+
+// n alternating call and put strikes from lo to hi
+static std::vector<double> strikes(std::size_t n, double lo = 50, double hi = 150)
+{
+	std::vector<double> k(n);
+
+	for (std::size_t i = 0; i < n; ++i)
+		k[i] = (i%2 ? -1 : 1)*(lo + (hi - lo)*i/n);
+
+	return k;
+}
+
+// array results match the scalar entry points with scalar arguments broadcast
+static void test_value_array(void)
+{
+	std::vector<double> k = strikes(1000);
+	FPX f(1, 1), s(1, 1), K = column(k), t(1, 1);
+	f[0] = 100; s[0] = .2; t[0] = .25;
+
+	xfp* pv = xll_black_value_array(f.get(), s.get(), K.get(), t.get());
+	check (pv == K.get());
+	check (size(*pv) == k.size());
+	for (std::size_t i = 0; i < k.size(); ++i)
+		check (close(pv->array[i], xll_black_value(100, .2, k[i], .25)));
+
+	// mismatched sizes are an error
+	FPX s2(2, 1);
+	s2[0] = s2[1] = .2;
+	check (xll_black_value_array(f.get(), s2.get(), K.get(), t.get()) == 0);
+	check (!last_error().empty());
+}
+
+static void test_greeks_array(void)
+{
+	std::vector<double> k = strikes(100);
+	FPX f(1, 1), s(1, 1), K = column(k), t(1, 1);
+	f[0] = 100; s[0] = .2; t[0] = .25;
+
+	xfp* pg = xll_black_greeks_array(f.get(), s.get(), K.get(), t.get());
+	check (pg && pg->rows == k.size() && pg->columns == 5);
+	for (std::size_t i = 0; i < k.size(); ++i) {
+		xfp* g = xll_black_greeks(100, .2, k[i], .25);
+		for (unsigned short j = 0; j < 5; ++j)
+			check (close(pg->array[5*i + j], g->array[j]));
+		check (close(pg->array[5*i + 1], xll_black_delta(100, .2, k[i], .25)));
+	}
+}
+
+static void test_implied_array(void)
+{
+	// away from the money the time value is too small to determine the volatility
+	std::vector<double> k = strikes(200, 80, 120), p(k.size());
+	for (std::size_t i = 0; i < k.size(); ++i)
+		p[i] = black::black(100, .1 + .002*i, k[i], .5);
+	p[7] = -1; // out of bounds
+
+	FPX P = column(p), K = column(k);
+	xfp* pv = xll_black_implied_volatility_array(100, P.get(), K.get(), .5);
+	check (pv == P.get());
+	for (std::size_t i = 0; i < k.size(); ++i) {
+		if (i == 7)
+			check (pv->array[i] != pv->array[i]);
+		else
+			check (close(pv->array[i], .1 + .002*i, 1e-8));
+	}
+	check (close(pv->array[3], xll_black_implied_volatility(100, p[3], k[3], .5), 1e-8));
+
+	// the status does not depend on ensure, and a failed solve leaves vol alone
+	double v = -1;
+	check (black::implied_solve(100, black::black(100, .3, -90, .25), -90, .25, .2, 1e-10, 100, &v) == black::implied_ok);
+	check (close(v, .3, 1e-8));
+	v = -1;
+	check (black::implied_solve(100, 101, 100, .25, .2, 1e-10, 100, &v) == black::implied_bounds && v == -1);
+	check (black::implied_solve(100, black::black(100, .3, 100, .25), 100, .25, .2, 1e-15, 0, &v) == black::implied_failed && v == -1);
+	check (black::implied_in_bounds(100, 11, 90, .25) && !black::implied_in_bounds(100, 10, 90, .25) && !black::implied_in_bounds(100, 100, 90, .25));
+	check (black::implied_in_bounds(100, 1, -90, .25) && !black::implied_in_bounds(100, 90, -90, .25) && !black::implied_in_bounds(100, 1, -90, 0));
+	int status[3];
+	double q[] = {black::black(100, .3, 100, .25), 0, black::black(100, .3, 110, .25)}, kq[] = {100, 100, 110};
+	black::implied_volatility(100, 3, q, kq, .25, q, status);
+	check (status[0] == black::implied_ok && status[1] == black::implied_bounds && status[2] == black::implied_ok);
+	check (close(q[2], .3, 1e-8) && q[1] != q[1]);
+}
+
+// concurrent calls to functions that return per-thread buffers do not interfere
+static void test_threads(void)
+{
+	const int n = 4;
+	std::vector<std::thread> th;
+	std::vector<int> bad(n, 0);
+
+	for (int j = 0; j < n; ++j) {
+		th.push_back(std::thread([j, &bad]() {
+			double k = 80 + 10*j;
+			double v = black::black(100, .2, k, .25);
+			for (int i = 0; i < 10000; ++i) {
+				xfp* g = xll_black_greeks(100, .2, k, .25);
+				if (g->array[0] != v)
+					++bad[j];
+			}
+		}));
+	}
+	for (int j = 0; j < n; ++j) {
+		th[j].join();
+		check (bad[j] == 0);
+	}
+}
+
+static void test_lkk(void)
+{
+	FPX x(3, 1);
+	x[0] = -1; x[1] = 0; x[2] = 1;
+
+	xfp* px = xll_lkk_cdf(x.get(), .2, .01, .01);
+	check (px == x.get());
+	check (px->array[0] < px->array[1] && px->array[1] < px->array[2]);
+}
+
+static void test_memo(void)
+{
+	check (xll_memo_enable("BLACK.IMPLIED.VOLATILITY", TRUE) == FALSE);
+	double v0 = xll_black_implied_volatility(100, 4, 100, .25);
+	double v1 = xll_black_implied_volatility(100, 4, 100, .25);
+	double v2 = xll_black_implied_volatility(100, 4, 101, .25);
+	check (v0 == v1 && v0 != v2);
+	xfp* st = xll_memo_stats("BLACK.IMPLIED.VOLATILITY");
+	check (st && st->array[0] == 1 && st->array[1] == 1 && st->array[2] == 2 && st->array[4] == 2);
+	check (xll_memo_enable("BLACK.IMPLIED.VOLATILITY", FALSE) == TRUE);
+	check (xll_memo_stats("BLACK.IMPLIED.VOLATILITY")->array[4] == 0);
+	check (xll_memo_stats("NO.SUCH.FUNCTION") == 0);
+
+	// cached ranges are copied back in place
+	memo::base::find("LKK.CDF")->enable();
+	FPX x(2, 1), y(2, 1);
+	x[0] = y[0] = -.1; x[1] = y[1] = .1;
+	xll_lkk_cdf(x.get(), .2, .01, .01);
+	xll_lkk_cdf(y.get(), .2, .01, .01);
+	check (x[0] == y[0] && x[1] == y[1]);
+	check (memo::base::find("LKK.CDF")->hits() == 1);
+	memo::base::find("LKK.CDF")->enable(false);
+
+	// CLOCK keeps the size bounded
+	memo::cache<> c("test", 16, 1);
+	c.enable();
+	for (int i = 0; i < 100; ++i) {
+		double d = i;
+		memo::key k;
+		c(memo::append(k, 1, &d), [d]() { return 2*d; });
+	}
+	check (c.size() == 16 && c.evictions() == 84);
+
+	// concurrent readers and writers always see the value for their key
+	memo::cache<> cc("threads", 32, 4);
+	cc.enable();
+	std::vector<std::thread> th;
+	std::vector<int> bad(4, 0);
+	for (int j = 0; j < 4; ++j) {
+		th.push_back(std::thread([j, &cc, &bad]() {
+			for (int i = 0; i < 20000; ++i) {
+				double d = (i*7 + j)%64;
+				memo::key k;
+				if (cc(memo::append(k, 1, &d), [d]() { return d*d; }) != d*d)
+					++bad[j];
+			}
+		}));
+	}
+	for (int j = 0; j < 4; ++j) {
+		th[j].join();
+		check (bad[j] == 0);
+	}
+	check (cc.size() <= 32 && cc.hits() + cc.misses() == 80000);
+}
+
+#ifdef BMS_STATS
+// calls of each instrumented function, or -1 if it has not been called
+static double calls(const OPERX& o, const char* name)
+{
+	for (unsigned short i = 1; i < o.rows(); ++i)
+		if (o(i, 0).string() == name)
+			return o(i, 1);
+
+	return -1;
+}
+#endif
+
+static void test_stats(void)
+{
+	LPOPERX o = xll_bms_stats(TRUE);
+	check (o && o->columns() == 7 && o->rows() == 1 + bms_stats_count());
+	check ((*o)(0, 0).string() == "Function");
+#ifdef BMS_STATS
+	check (calls(*o, "BLACK.VALUE") > 0);
+
+	std::vector<std::thread> th;
+	for (int j = 0; j < 4; ++j)
+		th.push_back(std::thread([]() {
+			for (int i = 0; i < 1000; ++i)
+				xll_black_value(100, .2, 100 + i%10, .25);
+		}));
+	for (int j = 0; j < 4; ++j)
+		th[j].join();
+
+	o = xll_bms_stats(FALSE);
+	check (calls(*o, "BLACK.VALUE") == 4000);
+	check (calls(*o, "BLACK.IMPLIED.VOLATILITY") == 0);
+	for (unsigned short i = 1; i < o->rows(); ++i) {
+		const OPERX& r = *o;
+		if (r(i, 1) > 0)
+			check (0 < r(i, 3) && r(i, 4) <= r(i, 5) && r(i, 5) <= r(i, 6) && r(i, 3) <= r(i, 6));
+	}
+
+	bms_stats_entry e;
+	check (bms_stats_get(bms_stats_count(), &e) != 0);
+	bms_stats_reset();
+	check (calls(*xll_bms_stats(FALSE), "BLACK.VALUE") == 0);
+
+	// every id below the count can be read while counters are being constructed, the counters live forever
+	std::atomic<bool> go(true);
+	int missing = 0;
+	std::thread reader([&go, &missing]() {
+		while (go) {
+			std::size_t n = bms_stats_count();
+			for (std::size_t i = 0; i < n; ++i) {
+				bms_stats_entry e;
+				missing += bms_stats_get(i, &e) != 0;
+			}
+		}
+	});
+	static std::aligned_storage<sizeof(stats::counter), alignof(stats::counter)>::type cs[256];
+	std::size_t n0 = bms_stats_count();
+	std::vector<std::thread> tc;
+	for (int j = 0; j < 4; ++j)
+		tc.push_back(std::thread([j]() {
+			for (int i = 0; i < 64; ++i)
+				new (&cs[64*j + i]) stats::counter("TEST.COUNTER");
+		}));
+	for (int j = 0; j < 4; ++j)
+		tc[j].join();
+	go = false;
+	reader.join();
+	check (missing == 0 && bms_stats_count() == n0 + 256);
+#else
+	check (bms_stats_count() == 0);
+#endif
+}
+
+static void test_telemetry(void)
+{
+#ifdef BLACK_IMPLIED_TELEMETRY
+	using namespace black::telemetry;
+
+	reset();
+	std::vector<double> k = strikes(100, 80, 120), p(k.size());
+	for (std::size_t i = 0; i < k.size(); ++i)
+		p[i] = black::black(100, .3, k[i], 2);
+	p[0] = -1; // out of bounds, recorded without solving
+
+	FPX P = column(p), K = column(k);
+	xll_black_implied_volatility_array(100, P.get(), K.get(), 2);
+
+	// one expiration bucket, moneyness spread over the middle buckets, every call counted once
+	xfp* v = xll_black_implied_telemetry(FALSE);
+	check (v && v->columns == 13 + iteration_buckets && v->rows > 1);
+	double calls = 0, ends = 0, out = 0;
+	for (unsigned short i = 0; i < v->rows; ++i) {
+		const double* r = v->array + i*v->columns;
+		check (r[1] == 2);
+		calls += r[2];
+		ends += r[3] + r[4] + r[5] + r[6] + r[7] + r[8];
+		out += r[8];
+		check (r[7] == 0 && r[11] < 1e-10 && r[12] > 0);
+		// iteration histogram over the calls of the bucket, with the mean iterations
+		double m = 0, it = 0;
+		for (int j = 0; j < iteration_buckets; ++j) {
+			m += r[13 + j];
+			it += j*r[13 + j];
+		}
+		check (m == r[2] && close(it/m, r[10], 1e-12));
+	}
+	check (calls == k.size() && ends == calls && out == 1);
+
+	// the seed of each solve is the last volatility, so all but the first are lucky
+	histogram h = global();
+	std::size_t lucky_ = 0;
+	for (int i = 0; i < moneyness_buckets; ++i)
+		lucky_ += h.cells[i][expiration_buckets - 2].end[lucky];
+	check (lucky_ == k.size() - 2);
+
+	// scalar calls are recorded in last, failures included
+	xll_black_implied_volatility(100, black::black(100, .05, 100, .25), 100, .25);
+	check (last().end != failed && last().bracket > 0 && last().expiration == .25);
+	check (xll_black_implied_telemetry(TRUE)->rows > 1);
+	check (xll_black_implied_telemetry(FALSE)->rows == 1 && xll_black_implied_telemetry(FALSE)->array[2] == 0);
+	try {
+		black::implied_volatility(100, black::black(100, .3, 100, .25), 100, .25, .2, 1e-15, 0);
+	}
+	catch (const std::exception&) {
+	}
+	check (last().end == failed);
+	xll_black_implied_volatility(100, 101, 100, .25);
+	check (last().end == bounds);
+	double q[] = {-1, black::black(100, .3, 100, .25), 0}, kq[] = {100, 100, 110};
+	int status[3];
+	reset();
+	black::implied_volatility(100, 3, q, kq, .25, q, status);
+	histogram hb = global();
+	std::size_t n[paths] = {0};
+	for (int i = 0; i < moneyness_buckets; ++i)
+		for (int j = 0; j < expiration_buckets; ++j)
+			for (int e = 0; e < paths; ++e)
+				n[e] += hb.cells[i][j].end[e];
+	check (status[0] == black::implied_bounds && status[2] == black::implied_bounds);
+	check (n[bounds] == 2 && n[failed] == 0 && n[lucky] + n[bracketed] + n[bisection] + n[newton] == 1);
+
+	// scalar calls on several threads, read and reset while they run, are each counted once
+	reset();
+	std::vector<std::thread> th;
+	for (int j = 0; j < 4; ++j)
+		th.push_back(std::thread([j]() {
+			for (int i = 0; i < 2000; ++i)
+				black::implied_volatility(100, black::black(100, .2 + .01*j, 100 + i%10, .5), 100 + i%10, .5);
+		}));
+	std::size_t taken = 0;
+	for (int i = 0; i < 100; ++i) {
+		histogram h = global(true);
+		for (int m = 0; m < moneyness_buckets; ++m)
+			for (int e = 0; e < expiration_buckets; ++e)
+				taken += h.cells[m][e].calls;
+	}
+	for (int j = 0; j < 4; ++j)
+		th[j].join();
+	histogram h1 = global(true);
+	for (int m = 0; m < moneyness_buckets; ++m)
+		for (int e = 0; e < expiration_buckets; ++e)
+			taken += h1.cells[m][e].calls;
+	check (taken == 8000);
+#endif
+}
+
+static void test_queues(void)
+{
+	pipeline::spsc<int> s(4);
+	int x;
+	for (int i = 0; i < 4; ++i)
+		check (s.push(i));
+	check (!s.push(4));
+	check (s.pop(x) && x == 0 && s.push(4));
+
+	// every value from every producer arrives once and in each producer's order
+	const int n = 4, m = 20000;
+	pipeline::mpsc<int> q(64);
+	std::vector<std::thread> th;
+	for (int j = 0; j < n; ++j)
+		th.push_back(std::thread([j, &q]() {
+			for (int i = 0; i < m; ++i)
+				while (!q.push(j*m + i))
+					std::this_thread::yield();
+		}));
+	std::vector<int> next(n, 0);
+	int bad = 0;
+	for (int got = 0; got < n*m; ) {
+		if (!q.pop(x)) {
+			std::this_thread::yield();
+			continue;
+		}
+		bad += x % m != next[x/m]++;
+		++got;
+	}
+	for (int j = 0; j < n; ++j)
+		th[j].join();
+	check (bad == 0 && !q.pop(x));
+}
+
+static void test_pipeline(void)
+{
+	const std::size_t m = 7, n = 20000;
+	pipeline::engine e(m + 1, 2, 2, 16);
+	e.position(3, -2);
+	e.start();
+
+	// instrument m only has a price below intrinsic
+	pipeline::tick bad = {m, 100, 1, 50, 1, 0, pipeline::clock::time_point()};
+	e.push(bad);
+
+	std::vector<pipeline::tick> last(m);
+	for (std::size_t j = 0; j < n; ++j) {
+		pipeline::tick t;
+		t.instrument = j % m;
+		t.forward = 100 + (j % 13);
+		t.strike = t.instrument % 2 ? -95. : 105.;
+		t.expiration = .25 + .1*t.instrument;
+		t.price = black::value(t.forward, .1 + .01*(j % 17), t.strike, t.expiration);
+		t.time = 0;
+		e.push(t);
+		last[t.instrument] = t;
+	}
+	e.stop();
+
+	check (e.pushed() == n + 1 && e.solved() + e.failed() + e.conflated() == n + 1);
+	check (e.failed() == 1 && e.solved() > 0);
+	check (e.latency().count() == e.solved());
+
+	// each instrument ends on its last valid tick and the portfolio sums them
+	double value = 0, delta = 0;
+	for (std::size_t i = 0; i < m; ++i) {
+		pipeline::greeks g = {};
+		check (e.last(i, g));
+		const pipeline::tick& t = last[i];
+		double d, v = black::greeks(t.forward, g.volatility, t.strike, t.expiration, &d);
+		check (g.forward == t.forward && close(black::value(t.forward, g.volatility, t.strike, t.expiration), t.price, 1e-8));
+		check (close(g.value, v, 1e-14) && close(g.delta, d, 1e-14));
+		value += (i == 3 ? -2 : 1)*g.value;
+		delta += (i == 3 ? -2 : 1)*g.delta;
+	}
+	pipeline::greeks g;
+	check (!e.last(m, g));
+	check (close(e.portfolio().value, value, 1e-9) && close(e.portfolio().delta, delta, 1e-9));
+}
+
+// the batch pdf matches the scalar one and the density integrates to its mass
+static void test_lkk_pdf(void)
+{
+	lkk::distribution d(.3, .02, .01);
+	std::vector<double> x(801), y(801);
+	for (std::size_t i = 0; i < x.size(); ++i)
+		x[i] = -4 + .01*i;
+
+	d.pdf(x.size(), &x[0], &y[0]);
+	double m = 0;
+	for (std::size_t i = 0; i < x.size(); ++i) {
+		check (y[i] == d.pdf(x[i]));
+		check (y[i] == (lkk::pdf<double,double,double,double,double>(x[i], .3, .02, .01)));
+		m += .01*y[i];
+	}
+	check (close(m, d.mass(), 1e-10));
+	check (close(d.mass(), M_PI*M_PI/10));
+}
+
+// closed form cdf and put against the trapezoid walk they replaced, to its discretization error
+static void test_lkk_closed_form(void)
+{
+	const double s = .3, a = .02, b = .01;
+
+	for (double x = -1; x <= 1; x += .25)
+		check (close((lkk::cdf<double,double,double,double,double>(x, s, a, b)),
+			(lkk::cdf_trapezoid<double,double,double,double,double>(x, s, a, b)), 1e-6));
+	for (double k = 80; k <= 120; k += 10)
+		check (close((lkk::put<double,double,double,double,double>(100, s, a, b, k, 1)),
+			(lkk::put_trapezoid<double,double,double,double,double>(100, s, a, b, k, 1)), 1e-5));
+}
+
+// array cdf and put match the scalar versions for unsorted input, in place
+static void test_lkk_array(void)
+{
+	const double s = .3, a = .02, b = .01;
+	double x[] = {.5, -1, 0, .1, -.3}, k[] = {110, 90, 100, 95, 130};
+	const std::size_t n = sizeof(x)/sizeof(*x);
+	double y[n], p[n];
+
+	lkk::cdf(n, x, y, s, a, b);
+	lkk::put(100, s, a, b, n, k, p, 1);
+	for (std::size_t i = 0; i < n; ++i) {
+		check (close(y[i], (lkk::cdf<double,double,double,double,double>(x[i], s, a, b)), 1e-14));
+		check (close(p[i], (lkk::put<double,double,double,double,double>(100, s, a, b, k[i], 1)), 1e-13));
+	}
+
+	lkk::put(100, s, a, b, n, k, k, 1);
+	for (std::size_t i = 0; i < n; ++i)
+		check (k[i] == p[i]);
+}
+
+// Carr-Madan puts of the LKK characteristic function match the closed form put, as LKK.FFT.PUT does
+static void test_fft(void)
+{
+	const double f = 100, s = .3, a = .02, b = .01;
+	lkk::distribution d(s, a, b);
+	double c = log(f) - lkk::kappa(s, a, a, b, b);
+	const std::complex<double> I(0, 1);
+
+	fft::carr_madan cm([&](const std::complex<double>& u) { return exp(I*u*c)*d.characteristic(u); }, log(f));
+	for (double k = 70; k <= 130; k += 5)
+		check (fabs(cm.put(k) - (lkk::put<double,double,double,double,double>(f, s, a, b, k, 1))) < 1e-6*f);
+
+	// strikes off the grid throw
+	bool thrown = false;
+	try {
+		cm.call(1e-300);
+	}
+	catch (const std::out_of_range&) {
+		thrown = true;
+	}
+	check (thrown);
+}
+
+// the tabulated LKK quantile inverts the normalized cdf to 1e-6 in probability and is increasing
+static void test_lkk_quantile(void)
+{
+	lkk::quantile q(.3, .02, .01);
+	const lkk::distribution& d = q.density();
+	std::vector<double> u(9999), x(9999);
+	for (std::size_t i = 0; i < u.size(); ++i)
+		u[i] = (i + 1)/1e4;
+
+	q(u.size(), &u[0], &x[0]);
+	for (std::size_t i = 0; i < u.size(); ++i) {
+		check (fabs(d.cdf(x[i])/d.mass() - u[i]) < 1e-6);
+		check (x[i] == q(u[i]));
+		if (i)
+			check (x[i - 1] < x[i]);
+	}
+
+	// arguments outside (0, 1), NaN included, fail before indexing the table
+	double bad[] = {-.5, 0, 1, 2, std::numeric_limits<double>::quiet_NaN()};
+	for (int i = 0; i < 5; ++i) {
+		bool threw = false;
+		try {
+			q(bad[i]);
+		}
+		catch (const std::exception&) {
+			threw = true;
+		}
+		check (threw);
+	}
+}
+
+// smile::implied recovers the volatility of chains priced by Black on a pool and reports bad prices
+static void test_smile(void)
+{
+	std::vector<smile::chain> c;
+	for (int j = 0; j < 6; ++j)
+		c.push_back(smile::chain(100, .25*(j + 1), strikes(41, 80, 120)));
+
+	parallel::pool pool(3);
+	std::vector<smile::result> r = smile::implied([](const smile::chain& c, double* p) {
+		for (std::size_t i = 0; i < c.k.size(); ++i)
+			p[i] = black::black(c.f, .1 + .1*c.t, c.k[i], c.t);
+		p[5] = 1e3; // above the forward
+	}, c, pool);
+
+	check (r.size() == c.size());
+	for (std::size_t j = 0; j < c.size(); ++j) {
+		for (std::size_t i = 0; i < c[j].k.size(); ++i) {
+			if (i == 5) {
+				check (r[j].status[i] == black::implied_bounds);
+				check (r[j].vol[i] != r[j].vol[i]);
+			}
+			else {
+				check (r[j].status[i] == black::implied_ok);
+				check (close(r[j].vol[i], .1 + .1*c[j].t, 1e-8));
+			}
+		}
+	}
+}
+
+// Philox4x32-10 known answers from the Random123 reference, and streams that do not depend on how they are split
+static void test_philox(void)
+{
+	const std::uint32_t ctr[3][4] = {
+		{0, 0, 0, 0},
+		{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+		{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}
+	};
+	const std::uint32_t key[3][2] = {{0, 0}, {0xffffffff, 0xffffffff}, {0xa4093822, 0x299f31d0}};
+	const std::uint32_t out[3][4] = {
+		{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+		{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+		{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}
+	};
+	for (int i = 0; i < 3; ++i) {
+		std::uint32_t w[4];
+		rng::philox::block(ctr[i], key[i], w);
+		for (int j = 0; j < 4; ++j)
+			check (w[j] == out[i][j]);
+	}
+
+	// the stream is the key and the substream the high half of the counter
+	rng::philox r(0xa4093822299f31d0ull, 0x03707344);
+	std::uint32_t c[4] = {0, 0, 0x03707344, 0}, k[2] = {0x299f31d0, 0xa4093822}, w[4];
+	rng::philox::block(c, k, w);
+	for (int j = 0; j < 4; ++j)
+		check (r() == w[j]);
+
+	// batches match scalar calls from any starting position
+	rng::philox s(7, 3), t(7, 3);
+	std::vector<double> u(1001);
+	s.real();
+	t.real();
+	s.real(u.size(), &u[0]);
+	for (std::size_t i = 0; i < u.size(); ++i)
+		check (u[i] == t.real() && 0 < u[i] && u[i] < 1);
+	check (s() == t());
+}
+
+// the hedging error of an at the money call follows sqrt(pi/4N) vega sigma and does not depend on the threads
+static void test_hedge(void)
+{
+	std::vector<hedge::futures::option> book(1);
+	book[0].k = 100;
+	book[0].amount = 1;
+	hedge::futures h(100, .2, 1, book);
+	h.steps(250);
+
+	parallel::pool one(1), three(3);
+	hedge::futures::result r = h.run(20000, one, 1), s = h.run(20000, three, 1);
+	double vega = black::vega(100, .2, 100, 1);
+	double sd = sqrt(M_PI/(4*250))*vega*.2;
+
+	check (fabs(sqrt(r.pnl.variance())/sd - 1) < .05);
+	check (fabs(r.pnl.mean()) < 4*sd/sqrt(20000.) + .01);
+	check (r.pnl.mean() == s.pnl.mean() && r.pnl.variance() == s.pnl.variance());
+	check (r.quantile.quantile(.5) == s.quantile.quantile(.5));
+}
+
+// exit times from (-1, 2): the table matches the exact inverse, and E[tau] = -lo hi and P(hi) = -lo/(hi - lo)
+static void test_exit_time(void)
+{
+	hedge::exit_time e(-1, 2), x(-1, 2, 0);
+
+	check (close(e.probability(), 1./3));
+	for (int i = 1; i < 1000; i += 7) {
+		double u = i/1000.;
+		for (int hi = 0; hi < 2; ++hi) {
+			double t = x.inverse(u, hi != 0), p = hi ? e.probability() : 1 - e.probability();
+			check (close(x.cdf(t, hi != 0)/p, u, 1e-12));
+			check (fabs(e.inverse(u, hi != 0) - t) <= 1e-6*t);
+		}
+	}
+
+	parallel::pool pool(2);
+	hedge::exit_time::result r = e.simulate(200000, pool, 1);
+	check (fabs(r.time.mean() - 2) < .02);
+	check (fabs(r.high.mean() - 1./3) < .005);
+}
+
+// the bridge on uneven times has covariance min(s, t) exactly and Sobol paths have variance t
+static void test_bridge(void)
+{
+	const double t[] = {.1, .25, .3, .7, 1, 1.6, 2};
+	const std::size_t m = sizeof(t)/sizeof(*t);
+	std::vector<double> T(t, t + m);
+
+	// with p = m paths of unit vectors the block is the matrix B of W = B z
+	brownian::bridge b(T);
+	std::vector<double> z(m*m, 0.), w(m*m);
+	for (std::size_t k = 0; k < m; ++k)
+		z[k*m + k] = 1;
+	b(m, &z[0], &w[0]);
+	for (std::size_t j = 0; j < m; ++j) {
+		for (std::size_t l = 0; l < m; ++l) {
+			double c = 0;
+			for (std::size_t i = 0; i < m; ++i)
+				c += w[j*m + i]*w[l*m + i];
+			check (close(c, std::min(t[j], t[l]), 1e-14));
+		}
+	}
+
+	parallel::pool pool(2);
+	brownian::paths p(T);
+	std::vector<statistics::moments> s = brownian::moments(p, 1 << 14, 1024, pool);
+	for (std::size_t j = 0; j < m; ++j) {
+		check (fabs(s[j].mean()) < 1e-3);
+		check (fabs(s[j].variance()/t[j] - 1) < 1e-2);
+	}
+}
+
+// The first 2^10 Sobol points put one point in each of 2^10 equal cells of every tabled dimension,
+// and the first two dimensions in each cell of a 32 x 32 grid. With Boost they also match
+// boost::random::sobol_engine in every tabled dimension.
+static void test_sobol(void)
+{
+	const std::size_t d = rng::sobol::table_dimension, m = 1024;
+	rng::sobol s(d);
+
+	std::vector<double> w(2*m);
+	for (std::size_t j = 0; j < d; ++j) {
+		std::vector<int> cell(m, 0);
+		s(j, 0, m, &w[0]);
+		for (std::size_t i = 0; i < m; ++i)
+			++cell[static_cast<std::size_t>(w[i]*m)];
+		check (std::count(cell.begin(), cell.end(), 1) == static_cast<std::ptrdiff_t>(m));
+	}
+	std::vector<int> box(m, 0);
+	s(0, 0, m, &w[0]);
+	s(1, 0, m, &w[m]);
+	for (std::size_t i = 0; i < m; ++i)
+		++box[32*static_cast<std::size_t>(w[i]*32) + static_cast<std::size_t>(w[m + i]*32)];
+	check (std::count(box.begin(), box.end(), 1) == static_cast<std::ptrdiff_t>(m));
+
+#ifdef HAVE_BOOST_SOBOL
+	const std::size_t n = 1000;
+	boost::random::sobol_engine<std::uint32_t, 32> e(d);
+	std::vector<double> u(d*n);
+
+	for (std::size_t j = 0; j < d; ++j)
+		s(j, 1, n, &u[j*n]);
+	for (std::size_t i = 0; i < n; ++i)
+		for (std::size_t j = 0; j < d; ++j)
+			check (u[j*n + i] == (e() + .5)/4294967296.);
+#endif
+}
+
+// lognormal X for montecarlo::european, the control variate is then exact
+struct lognormal_sampler {
+	double s;
+	void operator()(std::size_t n, const double* u, double* x) const
+	{
+		normal_inv<ooura>(n, u, x);
+		for (std::size_t i = 0; i < n; ++i)
+			x[i] *= s;
+	}
+};
+
+// Monte Carlo values against Black and the LKK closed form put, with a temporary sampler
+static void test_montecarlo(void)
+{
+	std::vector<double> k;
+	k.push_back(-90);
+	k.push_back(-100);
+	k.push_back(110);
+	parallel::pool pool(2);
+
+	lognormal_sampler ls = {.2};
+	montecarlo::european<lognormal_sampler> b(ls, 100, .02, 1, k, .2);
+	b.antithetic().seed(3).run(1 << 16, pool);
+	for (std::size_t j = 0; j < k.size(); ++j) {
+		double v = black::black(100, .2, k[j], 1);
+		check (fabs(b.plain(j).value - v) < 4*b.plain(j).error);
+		check (close(b.control(j).value, v, 1e-12));
+	}
+
+	// the sampler is normalized to mass 1, lkk::put integrates against the density with mass pi^2/10
+	const double s = .3, a = .02, bb = .01;
+	montecarlo::european<lkk::quantile> l(lkk::quantile(s, a, bb), 100, lkk::kappa(s, a, a, bb, bb), 1, k, s);
+	l.run(1 << 18, pool);
+	double mass = lkk::distribution(s, a, bb).mass();
+	for (std::size_t j = 0; j < 2; ++j) {
+		montecarlo::estimate e = l.control(j);
+		check (e.error < l.plain(j).error/4);
+		check (fabs(mass*e.value - (lkk::put<double,double,double,double,double>(100, s, a, bb, -k[j], 1))) < 4*mass*e.error + 1e-4);
+	}
+}
+
+// normal log return with variance v, the Black model when kap = v/2
+struct normal_law {
+	double v;
+	std::complex<double> characteristic(const std::complex<double>& u) const
+	{
+		return exp(-v*u*u/2.);
+	}
+};
+
+// COS against Black and against the LKK closed form put, which uses the same unnormalized measure
+static void test_cosine(void)
+{
+	double k[] = {-90, -100, 110, 120}, p[4];
+	normal_law n = {.04};
+	cosine::price(n, 100, 4, k, p, n.v/2);
+	for (int i = 0; i < 4; ++i)
+		check (close(p[i], black::black(100, .2, k[i], 1), 1e-10));
+
+	const double s = .3, a = .02, b = .01;
+	lkk::distribution d(s, a, b);
+	double kap = lkk::kappa(s, a, a, b, b);
+	double q[] = {-90, -100, -110, 110}, r[4];
+	cosine::price(d, 100, 4, q, r, kap);
+	for (int i = 0; i < 3; ++i)
+		check (close(r[i], (lkk::put<double,double,double,double,double>(100, s, a, b, -q[i], 1)), 1e-8));
+	// parity against the measure, int 100 exp(x - kap) - 110 dP(x)
+	check (close(r[3] - lkk::put<double,double,double,double,double>(100, s, a, b, 110, 1), 100*exp(-kap)*real(d.characteristic(std::complex<double>(0, -1))) - 110*d.mass(), 1e-8));
+}
+
+// moments of uniforms split and merged against one pass and theory, digest quantiles against ranks
+static void test_statistics(void)
+{
+	rng::philox r(5);
+	std::vector<double> x(1 << 16);
+	for (std::size_t i = 0; i < x.size(); ++i)
+		x[i] = r.real();
+
+	statistics::moments m, a, b;
+	m.add(x.size(), &x[0]);
+	a.add(x.size()/3, &x[0]);
+	b.add(x.size() - x.size()/3, &x[x.size()/3]);
+	a.merge(b);
+	check (a.count() == m.count());
+	check (close(a.mean(), m.mean(), 1e-12));
+	check (close(a.variance(), m.variance(), 1e-12));
+	check (close(a.kurtosis(), m.kurtosis(), 1e-10));
+	check (fabs(m.mean() - .5) < 4*m.error());
+	check (close(m.variance(), 1/12., 2e-2));
+	check (fabs(m.skewness()) < 3e-2);
+	check (close(m.kurtosis(), -1.2, 2e-2));
+
+	statistics::digest d, e;
+	d.add(x.size()/2, &x[0]);
+	e.add(x.size() - x.size()/2, &x[x.size()/2]);
+	d.merge(e);
+	check (d.count() == x.size());
+	check (d.size() < x.size()/10);
+	std::sort(x.begin(), x.end());
+	double q[] = {.001, .01, .5, .99, .999};
+	for (int i = 0; i < 5; ++i) {
+		double y = d.quantile(q[i]);
+		check (fabs(y - x[static_cast<std::size_t>(q[i]*x.size())]) < 1e-3);
+		check (fabs(d.cdf(y) - q[i]) < 1e-3);
+	}
+	check (d.quantile(0) == x.front() && d.quantile(1) == x.back());
+}
+
+int main(void)
+{
+	test_registry();
+	test_value_array();
+	test_greeks_array();
+	test_implied_array();
+	test_threads();
+	test_lkk();
+	test_memo();
+	test_stats();
+	test_telemetry();
+	test_queues();
+	test_pipeline();
+	test_lkk_pdf();
+	test_lkk_closed_form();
+	test_lkk_array();
+	test_fft();
+	test_lkk_quantile();
+	failures += test_jiejie();
+	test_smile();
+	test_philox();
+	test_hedge();
+	test_exit_time();
+	test_bridge();
+	test_sobol();
+	test_montecarlo();
+	test_cosine();
+	test_statistics();
+
+	std::printf("%s: %d failure%s\n", failures ? "FAILED" : "passed", failures, failures == 1 ? "" : "s");
+
+	return failures != 0;
+}
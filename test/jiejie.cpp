@@ -0,0 +1,230 @@
+// jiejie.cpp - harness tests of the jiejie branch. normalexp.h includes the branch copy of normal.h,
+// which cannot share a translation unit with the trunk one, so these run from their own file.
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "../branches/jiejie/normalexp.h"
+#include "../branches/jiejie/XlltestProj/putPricer.h"
+#include "../branches/jiejie/XlltestProj/calibrate.h"
+#include "../parallel.h"
+#if defined(__has_include)
+#if __has_include(<boost/math/tools/roots.hpp>)
+#include "../branches/jiejie/bms.h"
+#define HAVE_BOOST_MATH
+#endif
+#endif
+
+static int failures = 0;
+
+#define check(e) do { if (!(e)) { std::printf("%s:%d: %s\n", __FILE__, __LINE__, #e); ++failures; } } while (0)
+
+static bool close(double x, double y, double eps = 1e-12)
+{
+	return fabs(x - y) <= eps*(1 + fabs(y));
+}
+
+// the array members of normalexp match the free functions in every region
+static void test_normalexp(void)
+{
+	const double a = -1.5, b = 1.2, sigma = .3;
+	normalexp ne(a, -a, b, b);
+	std::vector<double> x(101), y(101), z(101), w(101);
+	for (std::size_t i = 0; i < x.size(); ++i)
+		x[i] = -4 + .08*i;
+
+	ne.pdf(x.size(), &x[0], &y[0]);
+	ne.cdf(x.size(), &x[0], &z[0]);
+	ne.cdf_exp(x.size(), &x[0], &w[0], sigma);
+	for (std::size_t i = 0; i < x.size(); ++i) {
+		check (close(y[i], normalexp_pdf(x[i], a, -a, b, b)));
+		check (close(y[i], ne.pdf(x[i])));
+		check (close(z[i], normalexp_cdf(x[i], a, -a, b, b)));
+		check (close(z[i], ne.cdf(x[i])));
+		check (close(w[i], normalexp_exp(x[i], sigma, a, -a, b, b)));
+		check (close(w[i], ne.cdf_exp(x[i], sigma)));
+	}
+
+	// the partial expectation is continuous at both ends of the body
+	check (close(normalexp_exp(a - 1e-12, sigma, a, -a, b, b), normalexp_exp(a, sigma, a, -a, b, b), 1e-10));
+	check (close(normalexp_exp(b - 1e-12, sigma, a, -a, b, b), normalexp_exp(b, sigma, a, -a, b, b), 1e-10));
+}
+
+// putChain is finite and continuous where sigma sqrt(t) equals b, and calls satisfy parity
+static void test_put_chain(void)
+{
+	const double k[] = {80, 100, 120, 150, 200};
+	const int n = sizeof(k)/sizeof(*k);
+	double p[n], q[n], c[n];
+
+	putChain(100, .2, 1, -1.5, .2, n, k, p);
+	putChain(100, nextafter(.2, 1.), 1, -1.5, .2, n, k, q);
+	for (int i = 0; i < n; ++i) {
+		check (p[i] > 0 && p[i] < k[i]);
+		check (close(p[i], q[i], 1e-12));
+		check (p[i] == putPricer(100, .2, k[i], 1, -1.5, .2));
+	}
+
+	// the call forward is the normalexp mean of s0 exp(sigma sqrt(t) X - sigma^2 t/2)
+	putChain(100, .2, 1, -1.5, 2, n, k, p, c);
+	normalexp ne(-1.5, 1.5, 2, 2);
+	double f = 100*exp(-.02)*ne.cdf_exp(HUGE_VAL, .2);
+	for (int i = 0; i < n; ++i)
+		check (close(c[i] - p[i], f - k[i], 1e-10));
+}
+
+// the analytic gradient matches central differences, including where sigma sqrt(t) equals b
+static void test_put_gradient(void)
+{
+	const double s0 = 100, t = 1, k[] = {70, 90, 100, 110, 140};
+	const double sigma[] = {.3, .2}, a = -1.5, b[] = {2, .2};
+
+	for (int j = 0; j < 2; ++j) {
+		for (int i = 0; i < 5; ++i) {
+			double g[3], h = 1e-6;
+			double p = putGradient(s0, sigma[j], k[i], t, a, b[j], g);
+
+			check (close(p, putPricer(s0, sigma[j], k[i], t, a, b[j]), 1e-10));
+			double ds = (putPricer(s0, sigma[j] + h, k[i], t, a, b[j]) - putPricer(s0, sigma[j] - h, k[i], t, a, b[j]))/(2*h);
+			double da = (putPricer(s0, sigma[j], k[i], t, a + h, b[j]) - putPricer(s0, sigma[j], k[i], t, a - h, b[j]))/(2*h);
+			double db = (putPricer(s0, sigma[j], k[i], t, a, b[j] + h) - putPricer(s0, sigma[j], k[i], t, a, b[j] - h))/(2*h);
+			check (fabs(g[0] - ds) < 1e-5*(1 + fabs(ds)));
+			check (fabs(g[1] - da) < 1e-5*(1 + fabs(da)));
+			check (fabs(g[2] - db) < 1e-5*(1 + fabs(db)));
+		}
+	}
+}
+
+// Levenberg-Marquardt recovers the parameters of a synthetic surface, serially and on a pool
+static void test_calibrate(void)
+{
+	const normalexpParams truth[] = {{.25, -1.2, 1.8}, {.2, -1.6, 1.4}, {.3, -1.0, 2.2}};
+	const int m = sizeof(truth)/sizeof(*truth);
+	std::vector<normalexpQuotes> q(m);
+	for (int j = 0; j < m; ++j) {
+		q[j].s0 = 100;
+		q[j].t = .5*(j + 1);
+		for (int i = 0; i < 40; ++i)
+			q[j].k.push_back(60 + 2*i);
+		q[j].put.resize(q[j].k.size());
+		putChain(100, truth[j].sigma, q[j].t, truth[j].a, truth[j].b, 40, &q[j].k[0], &q[j].put[0]);
+	}
+
+	parallel::pool pool(2);
+	for (int run = 0; run < 2; ++run) {
+		std::vector<normalexpParams> p(m);
+		std::vector<int> iterations;
+		for (int j = 0; j < m; ++j) {
+			p[j].sigma = .22;
+			p[j].a = -1.4;
+			p[j].b = 1.6;
+		}
+
+		if (run)
+			calibrateSurface(q, p, &iterations, [&pool](std::size_t n, const std::function<void(std::size_t)>& f) { pool.run(n, f); });
+		else
+			calibrateSurface(q, p, &iterations);
+
+		for (int j = 0; j < m; ++j) {
+			check (iterations[j] > 0 && iterations[j] < 50);
+			check (fabs(p[j].sigma - truth[j].sigma) < 1e-6);
+			check (fabs(p[j].a - truth[j].a) < 1e-5);
+			check (fabs(p[j].b - truth[j].b) < 1e-5);
+		}
+	}
+}
+
+#ifdef HAVE_BOOST_MATH
+// bms.h state greeks match black::black from black.h and the black_data formulas they cache
+static void test_bms_state(void)
+{
+	typedef black<> B;
+	// f, k, t, sigma, value, delta, gamma, vega, theta of calls from black::black in black.h
+	const double c[][9] = {
+		{100, 100, 1, .2, 7.965567455405818, 0.5398278372770291, 0.019847627373850589, 39.695254747701178, -3.9695254747701183},
+		{100, 80, .5, .3, 21.425435555276877, 0.87656284102313597, 0.0096189982651574447, 14.428497397736171, -4.328549219320851},
+		{100, 130, 2, .25, 5.3122894115876065, 0.28593435196716555, 0.0096175007515158367, 48.087503757579192, -3.0054689848486995},
+		{50, 60, .25, .4, 1.0736494052890713, 0.20850836168401488, 0.028699452768474611, 7.1748631921186519, -5.7398905536949218},
+	};
+
+	for (std::size_t i = 0; i < sizeof(c)/sizeof(*c); ++i) {
+		const double f = c[i][0], sigma = c[i][3];
+		B::option o(c[i][1], c[i][2]);
+		B::state s(o, f, sigma);
+
+		check (s.srt == o.srt(sigma));
+		check (s.d1 == o.d1(f, sigma));
+		check (s.d2 == o.d2(f, sigma));
+		check (s.Nd1 == o.Nd1(f, sigma));
+		check (s.Nd2 == o.Nd2(f, sigma));
+		check (s.nd1 == o.nd1(f, sigma));
+
+		double g[4] = {0, 0, 0, 0};
+		double v = B::greeks(o, s, B::call, f, sigma, &g[0], &g[1], &g[2], &g[3]);
+		for (int j = 0; j < 4; ++j)
+			check (close(g[j], c[i][5 + j], 1e-13));
+		check (close(v, c[i][4], 1e-13));
+
+		// without a state greeks evaluates one, and value is greeks without the greeks
+		double h[4] = {0, 0, 0, 0};
+		check (B::greeks(o, B::call, f, sigma, &h[0], &h[1], &h[2], &h[3]) == v);
+		for (int j = 0; j < 4; ++j)
+			check (h[j] == g[j]);
+		check (B::value(o, B::call, f, sigma) == v);
+
+		// greeks are incremented and cp weights the value and delta
+		check (close(B::greeks(o, s, 2, f, sigma, &g[0], &g[1], &g[2], &g[3]), 2*v));
+		check (close(g[0], 3*c[i][5], 1e-13));
+		check (close(g[1], 2*c[i][6], 1e-13));
+	}
+}
+
+// implied_halley round trips calls from deep in to deep out of the money within its iteration limit
+// and takes about half the pricing calls of implied, which brackets and bisects to the same accuracy
+static void test_bms_implied_halley(void)
+{
+	typedef black<> B;
+	const double k[] = {50, 70, 80, 90, 95, 100, 105, 110, 120, 140, 170, 200, 250, 300};
+	const double t[] = {.1, .5, 1, 3, 10};
+	// not the guess .2 times a power of 2, which bracketing by factors of 2 would land on exactly
+	const double sigma[] = {.07, .13, .3, .55, 1.1};
+	boost::uintmax_t halley = 0, bracket = 0;
+
+	for (std::size_t i = 0; i < sizeof(k)/sizeof(*k); ++i) {
+		for (std::size_t j = 0; j < sizeof(t)/sizeof(*t); ++j) {
+			for (std::size_t l = 0; l < sizeof(sigma)/sizeof(*sigma); ++l) {
+				B::option o(k[i], t[j]);
+				double v = B::value(o, B::call, 100, sigma[l]);
+				if (v - (k[i] < 100 ? 100 - k[i] : 0) < .01)
+					continue; // too little time value to determine the volatility
+
+				boost::uintmax_t n = 20;
+				double s = B::implied_halley(o, B::call, 100, v, .2, n);
+				check (n < 20);
+				check (fabs(s - sigma[l]) < 1e-12*sigma[l]);
+				halley += n;
+
+				n = 100;
+				s = B::implied(o, B::call, 100, v, .2, 2, boost::math::tools::eps_tolerance<double>(52), n);
+				check (fabs(s - sigma[l]) < 1e-12*sigma[l]);
+				bracket += n;
+			}
+		}
+	}
+	// 1299 against 2740 pricing calls for the 267 calls with enough time value
+	check (3*halley < 2*bracket);
+}
+#endif
+
+int test_jiejie(void)
+{
+	test_normalexp();
+	test_put_chain();
+	test_put_gradient();
+	test_calibrate();
+#ifdef HAVE_BOOST_MATH
+	test_bms_state();
+	test_bms_implied_halley();
+#endif
+
+	return failures;
+}
@@ -0,0 +1,213 @@
+// xll.h - minimal stand in for the xll library so add-in sources build and run on Linux.
+// Registrations are recorded instead of being sent to Excel and FP arrays are plain structs,
+// so a harness can call the exported functions directly.
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define ensure(e) do { if (!(e)) throw std::runtime_error("ensure: " #e); } while (0)
+
+#define _T(x) x
+#define WINAPI
+#define ENT_plusmn "&#177;"
+
+#define XLL_BOOLX    "A"
+#define XLL_DOUBLEX  "B"
+#define XLL_CSTRINGX "C"
+#define XLL_FPX      "K"
+#define XLL_LPOPERX  "Q"
+
+typedef short BOOL;
+#define TRUE 1
+#define FALSE 0
+
+struct XLOPERX { };
+
+// Excel FP array with rows*columns doubles
+struct _FP {
+	unsigned short rows;
+	unsigned short columns;
+	double array[1];
+};
+
+namespace xll {
+
+	template<class X> struct traits;
+	template<> struct traits<XLOPERX> {
+		typedef const char* xcstr;
+		typedef _FP xfp;
+		typedef unsigned short xword;
+	};
+
+	inline unsigned short size(const _FP& a)
+	{
+		return static_cast<unsigned short>(a.rows*a.columns);
+	}
+
+	// owning FP array
+	class FPX {
+		std::vector<double> buf_;
+		_FP* fp_;
+
+		void alloc(unsigned short r, unsigned short c)
+		{
+			std::size_t n = static_cast<std::size_t>(r)*c;
+			buf_.assign(1 + (n ? n : 1), 0.); // the header pads to one double
+			fp_ = reinterpret_cast<_FP*>(&buf_[0]);
+			fp_->rows = r;
+			fp_->columns = c;
+		}
+	public:
+		FPX(unsigned short r = 1, unsigned short c = 1)
+		{
+			alloc(r, c);
+		}
+		FPX(const FPX& x)
+		{
+			alloc(x.rows(), x.columns());
+			std::memcpy(fp_->array, x.fp_->array, size()*sizeof(double));
+		}
+		FPX& operator=(const FPX& x)
+		{
+			if (this != &x) {
+				alloc(x.rows(), x.columns());
+				std::memcpy(fp_->array, x.fp_->array, size()*sizeof(double));
+			}
+
+			return *this;
+		}
+		FPX& operator=(double x)
+		{
+			for (unsigned short i = 0; i < size(); ++i)
+				fp_->array[i] = x;
+
+			return *this;
+		}
+
+		unsigned short rows(void) const { return fp_->rows; }
+		unsigned short columns(void) const { return fp_->columns; }
+		unsigned short size(void) const { return xll::size(*fp_); }
+		void resize(unsigned short r, unsigned short c) { alloc(r, c); }
+
+		double& operator[](unsigned short i) { return fp_->array[i]; }
+		double operator[](unsigned short i) const { return fp_->array[i]; }
+		double& operator()(unsigned short i, unsigned short j) { return fp_->array[i*columns() + j]; }
+		double operator()(unsigned short i, unsigned short j) const { return fp_->array[i*columns() + j]; }
+
+		_FP* get(void) { return fp_; }
+		const _FP* get(void) const { return fp_; }
+	};
+
+	// cell or range of numbers and strings
+	class OPERX {
+		unsigned short rows_, columns_;
+		std::vector<OPERX> a_;
+		bool str_;
+		std::string s_;
+		double x_;
+	public:
+		OPERX(double x = 0)
+			: rows_(1), columns_(1), str_(false), x_(x)
+		{ }
+		OPERX(const char* s)
+			: rows_(1), columns_(1), str_(true), s_(s), x_(0)
+		{ }
+
+		void resize(unsigned short r, unsigned short c)
+		{
+			rows_ = r;
+			columns_ = c;
+			a_.assign(static_cast<std::size_t>(r)*c, OPERX());
+		}
+		unsigned short rows(void) const { return rows_; }
+		unsigned short columns(void) const { return columns_; }
+		bool is_string(void) const { return str_; }
+		const std::string& string(void) const { return s_; }
+		operator double() const { return x_; }
+
+		OPERX& operator()(unsigned short i, unsigned short j) { return a_[i*columns_ + j]; }
+		const OPERX& operator()(unsigned short i, unsigned short j) const { return a_[i*columns_ + j]; }
+	};
+	typedef OPERX* LPOPERX;
+
+	// what an add-in registered
+	struct registration {
+		std::string type, procedure, name, category;
+		std::vector<std::string> args;
+		bool thread_safe;
+	};
+	inline std::vector<registration>& registry(void)
+	{
+		static std::vector<registration> r;
+
+		return r;
+	}
+
+	// last error reported by an add-in function on this thread
+	inline std::string& last_error(void)
+	{
+		thread_local std::string e;
+
+		return e;
+	}
+
+	class FunctionX {
+		registration r_;
+	public:
+		FunctionX(const char* type, const char* procedure, const char* name)
+		{
+			r_.type = type;
+			r_.procedure = procedure;
+			r_.name = name;
+			r_.thread_safe = false;
+		}
+		FunctionX& Arg(const char* type, const char* name, const char*)
+		{
+			r_.args.push_back(std::string(type) + " " + name);
+
+			return *this;
+		}
+		FunctionX& Num(const char* name, const char* help, double)
+		{
+			return Arg(XLL_DOUBLEX, name, help);
+		}
+		FunctionX& ThreadSafe(void)
+		{
+			r_.thread_safe = true;
+
+			return *this;
+		}
+		FunctionX& Category(const char* c)
+		{
+			r_.category = c;
+
+			return *this;
+		}
+		FunctionX& FunctionHelp(const char*)
+		{
+			return *this;
+		}
+		FunctionX& Documentation(const char* = 0)
+		{
+			return *this;
+		}
+		const registration& get(void) const
+		{
+			return r_;
+		}
+	};
+
+	struct AddInX {
+		AddInX(const FunctionX& f)
+		{
+			registry().push_back(f.get());
+		}
+	};
+
+} // namespace xll
+
+#define XLL_ERROR(e) (xll::last_error() = (e))
@@ -1,7 +1,10 @@
 // black.cpp - Fischer Black model that uses forwards and no rates.
 // Copyright (c) 2006-2009 KALX, LLC. All rights reserved. No warranty is made.
-#include "../xll8/xll/xll.h"
-#include "../fmsgjr/black.h"
+#include <vector>
+#include "xll/xll.h"
+#include "black.h"
+#include "memo.h"
+#include "stats.h"
 
 #define CATEGORY _T("XLL")
 #define PREFIX //CATEGORY _T(".")
@@ -12,10 +15,10 @@
 #define IS_EXPIRATION _T("is the time in years to option expiration.")
 #define IS_VALUE _T("is the option value.")
 
-using namespace fms;
 using namespace xll;
 
 typedef traits<XLOPERX>::xfp xfp;
+typedef traits<XLOPERX>::xword xword;
 /*
 #ifdef _DEBUG
 static AddInX xai_black_doc(
@@ -30,6 +33,7 @@ static AddInX xai_black_binary(
 	.Num(_T("Volatility"), IS_VOLATILITY, .2)
 	.Num(_T("Strike"),	IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the binary of a Black call or put option"))
 	.Documentation(
@@ -42,6 +46,7 @@ static AddInX xai_black_binary(
 double WINAPI xll_black_binary(double f, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.BINARY");
 	double x(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -61,6 +66,7 @@ static AddInX xai_black_value(
 	.Num(_T("Volatility"), IS_VOLATILITY, .2)
 	.Num(_T("Strike"),	IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the value of a Black call or put option"))
 	.Documentation(
@@ -73,6 +79,7 @@ static AddInX xai_black_value(
 double WINAPI xll_black_value(double f, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.VALUE");
 	double x(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -91,6 +98,7 @@ static AddInX xai_black_greeks(
 	.Num(_T("Volatility"), IS_VOLATILITY, .2)
 	.Num(_T("Strike"),	IS_STRIKE, 100.)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns a one column array of the value, delta, gamma, vega, and theta of a Black call or put option"))
 	.Documentation(R"(
@@ -104,7 +112,8 @@ static AddInX xai_black_greeks(
 xfp* WINAPI xll_black_greeks(double f, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
-	static FPX v(5, 1);
+	BMS_STATS_SCOPE("BLACK.GREEKS");
+	thread_local FPX v(5, 1); // one result per calculation thread
 
 	try {
 		v = 0;
@@ -119,12 +128,111 @@ xfp* WINAPI xll_black_greeks(double f, double sigma, double k, double t)
 	return v.get();
 }
 
+// Arguments of size 1 are broadcast to n using buf.
+static const double* broadcast(const xfp* px, xword n, std::vector<double>& buf)
+{
+	xword m = size(*px);
+	ensure (m == n || m == 1);
+
+	if (m == n)
+		return px->array;
+
+	buf.assign(n, px->array[0]);
+
+	return &buf[0];
+}
+
+static AddInX xai_black_value_array(
+	FunctionX(XLL_FPX, _T("?xll_black_value_array"), PREFIX _T("BLACK.VALUE.ARRAY"))
+	.Arg(XLL_FPX, _T("Forward"), IS_FORWARD)
+	.Arg(XLL_FPX, _T("Volatility"), IS_VOLATILITY)
+	.Arg(XLL_FPX, _T("Strike"), IS_STRIKE)
+	.Arg(XLL_FPX, _T("Expiration"), IS_EXPIRATION)
+	.ThreadSafe()
+	.Category(CATEGORY)
+	.FunctionHelp(_T("Returns the values of Black call or put options for ranges of arguments"))
+	.Documentation(
+		_T("Arguments with one cell are used for every option. ")
+		_T("The result has the shape of the largest argument. ")
+	)
+);
+xfp* WINAPI xll_black_value_array(xfp* pf, xfp* ps, xfp* pk, xfp* pt)
+{
+#pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.VALUE.ARRAY");
+	thread_local std::vector<double> f, s, k, t;
+	xfp* pv = pf;
+
+	try {
+		if (size(*ps) > size(*pv)) pv = ps;
+		if (size(*pk) > size(*pv)) pv = pk;
+		if (size(*pt) > size(*pv)) pv = pt;
+		xword n = size(*pv);
+
+		// the result overwrites the largest argument
+		black::black(n, broadcast(pf, n, f), broadcast(ps, n, s), broadcast(pk, n, k), broadcast(pt, n, t), pv->array);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
+
+	return pv;
+}
+
+static AddInX xai_black_greeks_array(
+	FunctionX(XLL_FPX, _T("?xll_black_greeks_array"), PREFIX _T("BLACK.GREEKS.ARRAY"))
+	.Arg(XLL_FPX, _T("Forward"), IS_FORWARD)
+	.Arg(XLL_FPX, _T("Volatility"), IS_VOLATILITY)
+	.Arg(XLL_FPX, _T("Strike"), IS_STRIKE)
+	.Arg(XLL_FPX, _T("Expiration"), IS_EXPIRATION)
+	.ThreadSafe()
+	.Category(CATEGORY)
+	.FunctionHelp(_T("Returns a five column array of the value, delta, gamma, vega, and theta of Black call or put options"))
+	.Documentation(
+		_T("Arguments with one cell are used for every option. ")
+		_T("There is one row for each cell of the largest argument. ")
+	)
+);
+xfp* WINAPI xll_black_greeks_array(xfp* pf, xfp* ps, xfp* pk, xfp* pt)
+{
+#pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.GREEKS.ARRAY");
+	thread_local FPX v;
+	thread_local std::vector<double> f, s, k, t, g;
+
+	try {
+		xword n = size(*pf);
+		if (size(*ps) > n) n = size(*ps);
+		if (size(*pk) > n) n = size(*pk);
+		if (size(*pt) > n) n = size(*pt);
+
+		g.resize(5*n);
+		black::black(n, broadcast(pf, n, f), broadcast(ps, n, s), broadcast(pk, n, k), broadcast(pt, n, t),
+			&g[0], &g[n], &g[2*n], &g[3*n], &g[4*n]);
+
+		v.resize(n, 5);
+		for (xword i = 0; i < n; ++i)
+			for (xword j = 0; j < 5; ++j)
+				v(i, j) = g[j*n + i];
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
+
+	return v.get();
+}
+
 static AddInX xai_black_delta(
 	FunctionX(XLL_DOUBLEX, _T("?xll_black_delta"), PREFIX _T("BLACK.DELTA"))
 	.Num(_T("Forward"), IS_FORWARD, 100)
 	.Num(_T("Volatility"), IS_VOLATILITY, .2)
 	.Num(_T("Strike"),	IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the delta of a Black call or put option"))
 	.Documentation(
@@ -137,6 +245,7 @@ static AddInX xai_black_delta(
 double WINAPI xll_black_delta(double f, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.DELTA");
 	double x(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -155,6 +264,7 @@ static AddInX xai_black_gamma(
 	.Num(_T("Volatility"), IS_VOLATILITY, .2)
 	.Num(_T("Strike"),	IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the gamma of a Black call or put option"))
 	.Documentation(
@@ -167,6 +277,7 @@ static AddInX xai_black_gamma(
 double WINAPI xll_black_gamma(double f, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.GAMMA");
 	double x(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -185,6 +296,7 @@ static AddInX xai_black_vega(
 	.Num(_T("Volatility"), IS_VOLATILITY, .2)
 	.Num(_T("Strike"),	IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the vega of a Black call or put option"))
 	.Documentation(
@@ -197,6 +309,7 @@ static AddInX xai_black_vega(
 double WINAPI xll_black_vega(double f, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.VEGA");
 	double x(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -215,6 +328,7 @@ static AddInX xai_black_theta(
 	.Num(_T("Volatility"), IS_VOLATILITY, .2)
 	.Num(_T("Strike"),	IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the theta of a Black call or put option"))
 	.Documentation(
@@ -227,6 +341,7 @@ static AddInX xai_black_theta(
 double WINAPI xll_black_theta(double f, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.THETA");
 	double x(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -245,6 +360,7 @@ static AddInX xai_corrado_miller_implied_volatility(
 	.Num(_T("Value"), IS_VALUE, 4)
 	.Num(_T("Strike"), IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the Corrado-Miller implied volatility of a Black call or put option"))
 	.Documentation(
@@ -258,6 +374,7 @@ double WINAPI
 xll_corrado_miller_implied_volatility(double f, double p, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("CM.IMPLIED.VOLATILITY");
 	double vol(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -270,12 +387,16 @@ xll_corrado_miller_implied_volatility(double f, double p, double k, double t)
 	return vol;
 }
 
+// opt in with MEMO.ENABLE
+static memo::cache<double, memo::fixed<4> > black_implied_volatility_cache("BLACK.IMPLIED.VOLATILITY");
+
 static AddInX xai_black_implied_volatility(
 	FunctionX(XLL_DOUBLEX, _T("?xll_black_implied_volatility"), PREFIX _T("BLACK.IMPLIED.VOLATILITY"))
 	.Num(_T("Forward"), IS_FORWARD, 100)
 	.Num(_T("Value"), IS_VALUE, 4)
 	.Num(_T("Strike"), IS_STRIKE, 100)
 	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the implied volatility of a Black call or put option"))
 	.Documentation(
@@ -289,10 +410,15 @@ double WINAPI
 xll_black_implied_volatility(double f, double p, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.IMPLIED.VOLATILITY");
 	double vol(std::numeric_limits<double>::quiet_NaN());
 
 	try {
-		vol = black::implied_volatility(f, p, k, t);
+		double x[] = {f, p, k, t};
+
+		vol = black_implied_volatility_cache(memo::make(x), [=]() {
+			return black::implied_volatility(f, p, k, t);
+		});
 	}
 	catch (const std::exception& ex) {
 		XLL_ERROR(ex.what());
@@ -301,6 +427,106 @@ xll_black_implied_volatility(double f, double p, double k, double t)
 	return vol;
 }
 
+static AddInX xai_black_implied_volatility_array(
+	FunctionX(XLL_FPX, _T("?xll_black_implied_volatility_array"), PREFIX _T("BLACK.IMPLIED.VOLATILITY.ARRAY"))
+	.Num(_T("Forward"), IS_FORWARD, 100)
+	.Arg(XLL_FPX, _T("Value"), IS_VALUE)
+	.Arg(XLL_FPX, _T("Strike"), IS_STRIKE)
+	.Num(_T("Expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
+	.Category(CATEGORY)
+	.FunctionHelp(_T("Returns the implied volatilities of Black call or put options on one forward and expiration"))
+	.Documentation(
+		_T("Values and strikes must have the same number of cells. ")
+		_T("Each solve starts from the last volatility found. ")
+		_T("Prices outside the no arbitrage bounds or that fail to converge return NaN. ")
+	)
+);
+xfp* WINAPI
+xll_black_implied_volatility_array(double f, xfp* pp, xfp* pk, double t)
+{
+#pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.IMPLIED.VOLATILITY.ARRAY");
+	try {
+		ensure (size(*pp) == size(*pk));
+
+		black::implied_volatility(f, size(*pp), pp->array, pk->array, t, pp->array);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
+
+	return pp;
+}
+
+#ifdef BLACK_IMPLIED_TELEMETRY
+
+static AddInX xai_black_implied_telemetry(
+	FunctionX(XLL_FPX, _T("?xll_black_implied_telemetry"), PREFIX _T("BLACK.IMPLIED.TELEMETRY"))
+	.Arg(XLL_BOOLX, _T("Reset"), _T("is an optional boolean to zero the counts after reading them. "))
+	.ThreadSafe()
+	.Category(CATEGORY)
+	.FunctionHelp(_T("Returns how implied volatilities were solved by moneyness and expiration bucket"))
+	.Documentation(
+		_T("One row for each bucket with calls. The columns are the lower moneyness log(k/f) and expiration of the bucket, ")
+		_T("calls, the number ending on the seed, an end of the bracket, bisection, Newton, failures, and prices out of bounds, ")
+		_T("the mean bracket steps, mean iterations, largest residual, mean nanoseconds per call, ")
+		_T("and 16 columns counting calls with 0, 1, ..., 14 and 15 or more bisection or Newton iterations. ")
+	)
+);
+xfp* WINAPI
+xll_black_implied_telemetry(BOOL reset)
+{
+#pragma XLLEXPORT
+	using namespace black::telemetry;
+	thread_local FPX v;
+
+	try {
+		histogram h = global(reset != FALSE);
+
+		xword n = 0;
+		for (int i = 0; i < moneyness_buckets; ++i)
+			for (int j = 0; j < expiration_buckets; ++j)
+				n += h.cells[i][j].calls > 0;
+
+		const int m = 3 + paths; // first column after the path counts
+		v.resize(n ? n : 1, m + 4 + iteration_buckets);
+		v = 0;
+		xword r = 0;
+		for (int i = 0; i < moneyness_buckets; ++i) {
+			for (int j = 0; j < expiration_buckets; ++j) {
+				const cell& c = h.cells[i][j];
+				if (c.calls == 0)
+					continue;
+
+				v(r, 0) = i ? moneyness_edge[i - 1] : -std::numeric_limits<double>::max();
+				v(r, 1) = j ? expiration_edge[j - 1] : 0;
+				v(r, 2) = static_cast<double>(c.calls);
+				for (int k = 0; k < paths; ++k)
+					v(r, 3 + k) = static_cast<double>(c.end[k]);
+				v(r, m) = static_cast<double>(c.bracket)/c.calls;
+				v(r, m + 1) = static_cast<double>(c.iterations)/c.calls;
+				v(r, m + 2) = c.residual;
+				v(r, m + 3) = c.ns/c.calls;
+				for (int k = 0; k < iteration_buckets; ++k)
+					v(r, m + 4 + k) = static_cast<double>(c.histogram[k]);
+				++r;
+			}
+		}
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
+
+	return v.get();
+}
+
+#endif // BLACK_IMPLIED_TELEMETRY
+
 #if 0
 static AddInX xai_black_implied_forward(
 	FunctionX(XLL_DOUBLEX, _T("?xll_black_implied_forward"), _T("BLACK.IMPLIED.FORWARD"))
@@ -308,6 +534,7 @@ static AddInX xai_black_implied_forward(
 	.Num(_T("volatility"), IS_VOLATILITY, .2)
 	.Num(_T("strike"), IS_STRIKE, 100)
 	.Num(_T("expiration"), IS_EXPIRATION, .25)
+	.ThreadSafe()
 	.Category(CATEGORY)
 	.FunctionHelp(_T("Returns the implied forward of a Black call or put option."))
 	.Documentation(
@@ -321,6 +548,7 @@ double WINAPI
 xll_black_implied_forward(double v, double sigma, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("BLACK.IMPLIED.FORWARD");
 	double f(std::numeric_limits<double>::quiet_NaN());
 
 	try {
@@ -1,6 +1,10 @@
 // xlllkk.cpp - Levy-Khintchine/Kolomogorov process
+#include <algorithm>
 #include "xll/xll.h"
 #include "lkk.h"
+#include "fft.h"
+#include "memo.h"
+#include "stats.h"
 
 using namespace xll;
 
@@ -13,6 +17,7 @@ static AddInX xai_lkk_pdf(
 	.Arg(XLL_DOUBLEX, _T("sigma"), _T("is the volatility. "))
 	.Arg(XLL_DOUBLEX, _T("a"), _T("is the low tail. "))
 	.Arg(XLL_DOUBLEX, _T("b"), _T("is the high tail. "))
+	.ThreadSafe()
 	.Category(_T("LKK"))
 	.FunctionHelp(_T("Returns the probability density function of the Levy-Khintchine/Kolomogorov distribution."))
 );
@@ -20,18 +25,29 @@ xfp* WINAPI
 xll_lkk_pdf(xfp* px, double s, double a, double b)
 {
 #pragma XLLEXPORT
-	for (xword i = 0; i < size(*px); ++i)
-		px->array[i] = lkk::pdf<double,double,double,double,double>(px->array[i], s, a, b);
+	BMS_STATS_SCOPE("LKK.PDF");
+	try {
+		lkk::distribution(s, a, b).pdf(size(*px), px->array, px->array);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
 
 	return px;
 }
 
+// opt in with MEMO.ENABLE
+static memo::cache<std::vector<double> > lkk_cdf_cache("LKK.CDF", 1 << 10);
+
 static AddInX xai_lkk_cdf(
 	FunctionX(XLL_FPX, _T("?xll_lkk_cdf"), _T("LKK.CDF"))
 	.Arg(XLL_FPX, _T("x"), _T("are the values at which to sample the distribution. "))
 	.Arg(XLL_DOUBLEX, _T("sigma"), _T("is the volatility. "))
 	.Arg(XLL_DOUBLEX, _T("a"), _T("is the low tail. "))
 	.Arg(XLL_DOUBLEX, _T("b"), _T("is the high tail. "))
+	.ThreadSafe()
 	.Category(_T("LKK"))
 	.FunctionHelp(_T("Returns the cumulative probability distribution of the Levy-Khintchine/Kolomogorov distribution."))
 );
@@ -39,11 +55,20 @@ xfp* WINAPI
 xll_lkk_cdf(xfp* px, double s, double a, double b)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("LKK.CDF");
 	try {
 		ensure (s*s - a - b > 0);
 
-		for (xword i = 0; i < size(*px); ++i)
-			px->array[i] = lkk::cdf<double,double,double,double,double>(px->array[i], s, a, b);
+		double sab[] = {s, a, b};
+		memo::key key;
+		memo::append(memo::append(key, 3, sab), size(*px), px->array);
+
+		std::vector<double> y = lkk_cdf_cache(key, [px, s, a, b]() {
+			std::vector<double> y(px->array, px->array + size(*px));
+			lkk::cdf(y.size(), &y[0], &y[0], s, a, b);
+			return y;
+		});
+		std::copy(y.begin(), y.end(), px->array);
 	}
 	catch (const std::exception& ex) {
 		XLL_ERROR(ex.what());
@@ -62,6 +87,7 @@ static AddInX xai_lkk_put(
 	.Arg(XLL_DOUBLEX, _T("b"), _T("is the high tail. "))
 	.Arg(XLL_DOUBLEX, _T("k"), _T("strike. "))
 	.Arg(XLL_DOUBLEX, _T("t"), _T("expiration. "))
+	.ThreadSafe()
 	.Category(_T("LKK"))
 	.FunctionHelp(_T("Returns the cumulative probability distribution of the Levy-Khintchine/Kolomogorov distribution."))
 );
@@ -69,12 +95,13 @@ double WINAPI
 xll_lkk_put(double f, double s, double a, double b, double k, double t)
 {
 #pragma XLLEXPORT
+	BMS_STATS_SCOPE("LKK.PUT");
 	double v;
 
 	try {
 		ensure (s*s - a - b > 0);
 
-			v = lkk::put<double,double,double,double,double>(f, s, a, b, k, t);
+		v = lkk::put<double,double,double,double,double>(f, s, a, b, k, t);
 	}
 	catch (const std::exception& ex) {
 		XLL_ERROR(ex.what());
@@ -84,3 +111,41 @@ xll_lkk_put(double f, double s, double a, double b, double k, double t)
 
 	return v;
 }
+
+static AddInX xai_lkk_fft_put(
+	FunctionX(XLL_FPX, _T("?xll_lkk_fft_put"), _T("LKK.FFT.PUT"))
+	.Arg(XLL_DOUBLEX, _T("f"), _T("forward. "))
+	.Arg(XLL_DOUBLEX, _T("sigma"), _T("volatility. "))
+	.Arg(XLL_DOUBLEX, _T("a"), _T("is the low tail. "))
+	.Arg(XLL_DOUBLEX, _T("b"), _T("is the high tail. "))
+	.Arg(XLL_FPX, _T("k"), _T("are the strikes. "))
+	.Arg(XLL_DOUBLEX, _T("t"), _T("expiration. "))
+	.ThreadSafe()
+	.Category(_T("LKK"))
+	.FunctionHelp(_T("Returns put values for all strikes using the Carr-Madan FFT of the Levy-Khintchine/Kolomogorov characteristic function."))
+);
+xfp* WINAPI
+xll_lkk_fft_put(double f, double s, double a, double b, xfp* pk, double t)
+{
+#pragma XLLEXPORT
+	BMS_STATS_SCOPE("LKK.FFT.PUT");
+	try {
+		ensure (s*s - a - b > 0);
+
+		lkk::distribution d(s, a, b);
+		double c = log(f) - lkk::kappa(s, a, a, b, b);
+		const std::complex<double> I(0, 1);
+
+		fft::carr_madan cm([&](const std::complex<double>& u) { return exp(I*u*c)*d.characteristic(u); }, log(f));
+
+		for (xword i = 0; i < size(*pk); ++i)
+			pk->array[i] = cm.put(pk->array[i]);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
+
+	return pk;
+}
@@ -0,0 +1,87 @@
+// xllmemo.cpp - control the result caches of the add-in functions.
+#include <string>
+#include "xll/xll.h"
+#include "memo.h"
+
+#ifndef CATEGORY
+#define CATEGORY _T("XLL")
+#endif
+
+using namespace xll;
+
+typedef traits<XLOPERX>::xcstr xcstr;
+typedef traits<XLOPERX>::xfp xfp;
+
+// cache names are ASCII function names
+static std::string narrow(xcstr s)
+{
+	std::string n;
+
+	for (; *s; ++s)
+		n += static_cast<char>(*s);
+
+	return n;
+}
+
+static AddInX xai_memo_enable(
+	FunctionX(XLL_BOOLX, _T("?xll_memo_enable"), _T("MEMO.ENABLE"))
+	.Arg(XLL_CSTRINGX, _T("Name"), _T("is the name of a function with a cache, e.g. BLACK.IMPLIED.VOLATILITY. "))
+	.Arg(XLL_BOOLX, _T("Enable"), _T("is true to cache results and false to stop caching and clear the cache. "))
+	.ThreadSafe()
+	.Category(CATEGORY)
+	.FunctionHelp(_T("Turn caching of a function's results on or off and return the previous setting"))
+	.Documentation(
+		_T("Results are keyed on the exact bits of the arguments. ")
+		_T("Caches start disabled. ")
+	)
+);
+BOOL WINAPI xll_memo_enable(xcstr name, BOOL b)
+{
+#pragma XLLEXPORT
+	BOOL b0 = FALSE;
+
+	try {
+		memo::base* m = memo::base::find(narrow(name));
+		ensure (m != 0);
+
+		b0 = m->enabled();
+		m->enable(b != FALSE);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return b0;
+}
+
+static AddInX xai_memo_stats(
+	FunctionX(XLL_FPX, _T("?xll_memo_stats"), _T("MEMO.STATS"))
+	.Arg(XLL_CSTRINGX, _T("Name"), _T("is the name of a function with a cache, e.g. BLACK.IMPLIED.VOLATILITY. "))
+	.ThreadSafe()
+	.Category(CATEGORY)
+	.FunctionHelp(_T("Returns a one row array of enabled, hits, misses, evictions, size, and capacity of a function's cache"))
+);
+xfp* WINAPI xll_memo_stats(xcstr name)
+{
+#pragma XLLEXPORT
+	thread_local FPX v(1, 6);
+
+	try {
+		memo::base* m = memo::base::find(narrow(name));
+		ensure (m != 0);
+
+		v[0] = m->enabled();
+		v[1] = static_cast<double>(m->hits());
+		v[2] = static_cast<double>(m->misses());
+		v[3] = static_cast<double>(m->evictions());
+		v[4] = static_cast<double>(m->size());
+		v[5] = static_cast<double>(m->capacity());
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
+
+	return v.get();
+}
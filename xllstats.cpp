@@ -0,0 +1,64 @@
+// xllstats.cpp - report call counts and latencies of the add-in functions.
+#include "xll/xll.h"
+#include "bms_c.h"
+#include "stats.h"
+
+#ifndef CATEGORY
+#define CATEGORY _T("XLL")
+#endif
+
+using namespace xll;
+
+static AddInX xai_bms_stats(
+	FunctionX(XLL_LPOPERX, _T("?xll_bms_stats"), _T("BMS.STATS"))
+	.Arg(XLL_BOOLX, _T("Reset"), _T("is an optional boolean to zero the counts after reading them. "))
+	.ThreadSafe()
+	.Category(CATEGORY)
+	.FunctionHelp(_T("Returns a table of calls, total, mean, median, 99th percentile, and maximum seconds of each function called so far"))
+	.Documentation(
+		_T("Functions are only timed when the add-in is built with BMS_STATS defined, ")
+		_T("otherwise the table has just the header row. ")
+	)
+);
+LPOPERX WINAPI xll_bms_stats(BOOL reset)
+{
+#pragma XLLEXPORT
+	thread_local OPERX o;
+
+	try {
+		std::size_t n = bms_stats_count();
+
+		o.resize(static_cast<unsigned short>(1 + n), 7);
+		o(0, 0) = _T("Function");
+		o(0, 1) = _T("Calls");
+		o(0, 2) = _T("Seconds");
+		o(0, 3) = _T("Mean");
+		o(0, 4) = _T("P50");
+		o(0, 5) = _T("P99");
+		o(0, 6) = _T("Max");
+
+		for (std::size_t i = 0; i < n; ++i) {
+			bms_stats_entry e;
+			ensure (bms_stats_get(i, &e) == 0);
+
+			unsigned short r = static_cast<unsigned short>(1 + i);
+			o(r, 0) = e.name;
+			o(r, 1) = static_cast<double>(e.calls);
+			o(r, 2) = e.seconds;
+			o(r, 3) = e.mean;
+			o(r, 4) = e.p50;
+			o(r, 5) = e.p99;
+			o(r, 6) = e.max;
+		}
+
+		if (reset)
+			bms_stats_reset();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return 0;
+	}
+
+	return &o;
+}